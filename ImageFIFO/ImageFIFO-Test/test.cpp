@@ -4,6 +4,7 @@
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <sstream>
 
 using namespace std::chrono;
 
@@ -515,4 +516,102 @@ TEST(MultiThread, Big)
 	t1.join();
 	t2.join();
 	EXPECT_EQ(v1, v2);
+}
+
+/* latency tracing */
+
+TEST(Tracing, DisabledByDefault)
+{
+	ImageFIFO fifo(sizeof(int), 10);
+	EXPECT_EQ(fifo.get_tracer(), nullptr);
+}
+
+TEST(Tracing, AllPhases)
+{
+	ImageFIFO fifo(sizeof(int), 2);
+	fifo.enable_tracing();
+	ASSERT_TRUE(fifo.get_tracer() != nullptr);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		int elem = i;
+		EXPECT_TRUE(writer(fifo, elem));
+		EXPECT_TRUE(reader(fifo, elem));
+	}
+
+	// 3 frames went through writing, ready and reading, the slot was reused twice
+	auto count = [&](FramePhase phase)
+	{
+		uint64_t sum = 0;
+		for (uint64_t n : fifo.get_tracer()->histogram(phase))
+		{
+			sum += n;
+		}
+		return sum;
+	};
+	EXPECT_EQ(count(FramePhase::Writing), 3);
+	EXPECT_EQ(count(FramePhase::Ready), 3);
+	EXPECT_EQ(count(FramePhase::Reading), 3);
+	EXPECT_EQ(count(FramePhase::Free), 2);
+	EXPECT_EQ(fifo.get_tracer()->events().size(), 11);
+}
+
+TEST(Tracing, SampleRate)
+{
+	ImageFIFO fifo(sizeof(int), 10);
+	fifo.enable_tracing(4);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		int elem = i;
+		EXPECT_TRUE(writer(fifo, elem));
+		EXPECT_TRUE(reader(fifo, elem));
+	}
+
+	size_t ready = 0;
+	for (const FrameTracer::Event& e : fifo.get_tracer()->events())
+	{
+		if (e.phase == FramePhase::Ready)
+		{
+			++ready;
+		}
+		EXPECT_LE(e.begin, e.end);
+	}
+	EXPECT_EQ(ready, 2);
+}
+
+TEST(Tracing, EnableAgainKeepsTracer)
+{
+	ImageFIFO fifo(sizeof(int), 10);
+	fifo.enable_tracing();
+	const FrameTracer* tracer = fifo.get_tracer();
+	int elem = 1;
+	writer(fifo, elem);
+	reader(fifo, elem);
+	size_t events = tracer->events().size();
+
+	fifo.enable_tracing(0);
+	EXPECT_EQ(fifo.get_tracer(), tracer);
+	EXPECT_EQ(tracer->events().size(), events);
+
+	// a sample rate of 0 traces no new frames, only the free phase of the traced one ends
+	writer(fifo, elem);
+	reader(fifo, elem);
+	EXPECT_EQ(tracer->events().size(), events + 1);
+}
+
+TEST(Tracing, ChromeTrace)
+{
+	ImageFIFO fifo(sizeof(char), 10);
+	fifo.enable_tracing();
+	char elem = 'a';
+	writer(fifo, elem);
+	reader(fifo, elem);
+
+	std::ostringstream os;
+	fifo.get_tracer()->dump_chrome_trace(os);
+	std::string json = os.str();
+	EXPECT_EQ(json.find("{\"traceEvents\":["), 0);
+	EXPECT_NE(json.find("\"name\":\"ready\""), std::string::npos);
+	EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
 }
\ No newline at end of file
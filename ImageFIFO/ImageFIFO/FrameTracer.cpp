@@ -0,0 +1,133 @@
+#include <bit>
+#include <iomanip>
+#include "FrameTracer.hpp"
+
+FrameTracer::FrameTracer(size_t num_slots, size_t _sample_rate, size_t _max_events)
+	: start(clock::now()), sample_rate(_sample_rate), max_events(_max_events)
+{
+	stamps.resize(num_slots, not_sampled);
+}
+
+int64_t FrameTracer::now() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+}
+
+void FrameTracer::record(size_t slot, FramePhase phase, bool keep_sampling)
+{
+	int64_t end = now();
+	int64_t begin = stamps[slot];
+	if (begin != not_sampled)
+	{
+		uint64_t dwell = end > begin ? static_cast<uint64_t>(end - begin) : 0;
+		size_t bucket = dwell > 0 ? std::bit_width(dwell) - 1 : 0;
+		histograms[static_cast<size_t>(phase)][bucket].fetch_add(1, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> guard(mutex_events);
+		if (trace.size() < max_events)
+		{
+			trace.push_back({ phase, slot, begin, end });
+		}
+	}
+	stamps[slot] = keep_sampling ? end : not_sampled;
+}
+
+void FrameTracer::set_sample_rate(size_t _sample_rate)
+{
+	sample_rate = _sample_rate;
+}
+
+void FrameTracer::on_get_free(size_t slot)
+{
+	// a new frame starts here, decide whether it is traced
+	bool sampled = sample_rate != 0 && counter.fetch_add(1, std::memory_order_relaxed) % sample_rate == 0;
+	record(slot, FramePhase::Free, sampled);
+}
+
+void FrameTracer::on_add_ready(size_t slot)
+{
+	record(slot, FramePhase::Writing, stamps[slot] != not_sampled);
+}
+
+void FrameTracer::on_get_ready(size_t slot)
+{
+	record(slot, FramePhase::Ready, stamps[slot] != not_sampled);
+}
+
+void FrameTracer::on_add_free(size_t slot)
+{
+	// keep the stamp so that the next get_free() measures the free dwell
+	record(slot, FramePhase::Reading, stamps[slot] != not_sampled);
+}
+
+FrameTracer::Histogram FrameTracer::histogram(FramePhase phase) const
+{
+	Histogram result{};
+	for (size_t i = 0; i < num_buckets; ++i)
+	{
+		result[i] = histograms[static_cast<size_t>(phase)][i].load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+std::vector<FrameTracer::Event> FrameTracer::events() const
+{
+	std::lock_guard<std::mutex> guard(mutex_events);
+	return trace;
+}
+
+const char* FrameTracer::phase_name(FramePhase phase)
+{
+	switch (phase)
+	{
+	case FramePhase::Free:
+		return "free";
+	case FramePhase::Writing:
+		return "busy (writing)";
+	case FramePhase::Ready:
+		return "ready";
+	case FramePhase::Reading:
+		return "busy (reading)";
+	}
+	return "unknown";
+}
+
+void FrameTracer::print_histograms(std::ostream& os) const
+{
+	for (size_t p = 0; p < num_phases; ++p)
+	{
+		FramePhase phase = static_cast<FramePhase>(p);
+		Histogram h = histogram(phase);
+		os << phase_name(phase) << ":\n";
+		for (size_t i = 0; i < num_buckets; ++i)
+		{
+			if (h[i] != 0)
+			{
+				os << "\t[2^" << i << ", 2^" << i + 1 << ") ns: " << h[i] << "\n";
+			}
+		}
+	}
+}
+
+void FrameTracer::dump_chrome_trace(std::ostream& os) const
+{
+	std::vector<Event> copy = events();
+	std::ios_base::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+	os << std::fixed << std::setprecision(3);
+
+	// complete ("X") events, one track per slot; ts and dur are in microseconds
+	os << "{\"traceEvents\":[";
+	for (size_t i = 0; i < copy.size(); ++i)
+	{
+		const Event& e = copy[i];
+		os << (i == 0 ? "\n" : ",\n");
+		os << "{\"name\":\"" << phase_name(e.phase) << "\",\"cat\":\"ImageFIFO\",\"ph\":\"X\""
+			<< ",\"ts\":" << e.begin / 1000.0
+			<< ",\"dur\":" << (e.end - e.begin) / 1000.0
+			<< ",\"pid\":0,\"tid\":" << e.slot << "}";
+	}
+	os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+	os.flags(flags);
+	os.precision(precision);
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+/* phases a frame goes through between two ImageFIFO transitions */
+
+enum class FramePhase
+{
+	Free,		// add_free  -> get_free
+	Writing,	// get_free  -> add_ready
+	Ready,		// add_ready -> get_ready
+	Reading,	// get_ready -> add_free
+};
+
+static const size_t num_phases = 4;
+static const size_t num_buckets = 64;	// bucket k counts dwell times in [2^k, 2^(k+1)) ns
+
+class FrameTracer
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using Histogram = std::array<uint64_t, num_buckets>;
+
+	struct Event
+	{
+		FramePhase phase;
+		size_t slot;
+		int64_t begin;	// ns since tracer creation
+		int64_t end;
+	};
+
+	FrameTracer(size_t num_slots, size_t _sample_rate = 1, size_t _max_events = 1 << 16);
+
+	/* transitions, called by ImageFIFO with the slot index */
+
+	void on_get_free(size_t slot);
+	void on_add_ready(size_t slot);
+	void on_get_ready(size_t slot);
+	void on_add_free(size_t slot);
+
+	// only while no transition runs, ImageFIFO holds both of its locks
+	void set_sample_rate(size_t _sample_rate);
+
+	/* export */
+
+	Histogram histogram(FramePhase phase) const;
+	std::vector<Event> events() const;
+
+	void print_histograms(std::ostream& os) const;
+	void dump_chrome_trace(std::ostream& os) const;
+
+	static const char* phase_name(FramePhase phase);
+
+private:
+	static constexpr int64_t not_sampled = -1;
+
+	clock::time_point start{};
+	size_t sample_rate{};
+	size_t max_events{};
+	std::atomic<size_t> counter{};
+
+	// time of the last transition of a sampled frame, one entry per slot;
+	// a slot is only touched by the thread that currently owns the frame
+	std::vector<int64_t> stamps;
+
+	std::array<std::array<std::atomic<uint64_t>, num_buckets>, num_phases> histograms{};
+
+	mutable std::mutex mutex_events{};
+	std::vector<Event> trace;
+
+	int64_t now() const;
+	void record(size_t slot, FramePhase phase, bool keep_sampling);
+};
\ No newline at end of file
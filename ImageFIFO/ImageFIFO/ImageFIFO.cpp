@@ -20,6 +20,10 @@ void* ImageFIFO::get_free()
 		if (free[i])
 		{
 			free[i] = false;
+			if (tracer)
+			{
+				tracer->on_get_free(i);
+			}
 			return static_cast<void*>(data[i].get());
 		}
 	}
@@ -33,6 +37,10 @@ void* ImageFIFO::get_ready()
 	{
 		void* ptr = ready.front();
 		ready.pop_front();
+		if (tracer)
+		{
+			tracer->on_get_ready(index_of(ptr));
+		}
 		return ptr;
 	}
 	return nullptr;
@@ -46,6 +54,10 @@ void ImageFIFO::add_free(void* ptr)
 		if (ptr == static_cast<void*>(data[i].get()) && !free[i])
 		{
 			free[i] = true;
+			if (tracer)
+			{
+				tracer->on_add_free(i);
+			}
 			return;
 		}
 	}
@@ -59,6 +71,10 @@ void ImageFIFO::add_ready(void* ptr)
 		if (ptr == static_cast<void*>(data[i].get()) && !is_ready(ptr))
 		{
 			ready.push_back(static_cast<void*>(data[i].get()));
+			if (tracer)
+			{
+				tracer->on_add_ready(i);
+			}
 			return;
 		}
 	}
@@ -102,4 +118,32 @@ bool ImageFIFO::is_ready(void* ptr)
 		}
 	}
 	return false;
+}
+
+size_t ImageFIFO::index_of(void* ptr)
+{
+	for (size_t i = 0; i < max; ++i)
+	{
+		if (ptr == static_cast<void*>(data[i].get()))
+		{
+			return i;
+		}
+	}
+	return max;
+}
+
+void ImageFIFO::enable_tracing(size_t sample_rate)
+{
+	std::scoped_lock guard(mutex_free, mutex_ready);
+	if (tracer)
+	{
+		tracer->set_sample_rate(sample_rate);
+		return;
+	}
+	tracer = std::make_unique<FrameTracer>(max, sample_rate);
+}
+
+const FrameTracer* ImageFIFO::get_tracer() const
+{
+	return tracer.get();
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <deque>
 #include <memory>
 #include <vector>
+#include "FrameTracer.hpp"
 
 class ImageFIFO
 {
@@ -20,6 +21,13 @@ public:
 	size_t num_busy();
 	size_t num_ready();
 
+	/* latency tracing, every sample_rate-th frame is traced */
+
+	// the tracer lives as long as the FIFO, calling this again keeps it and its data and
+	// only changes the sample rate, so the pointer from get_tracer() stays valid
+	void enable_tracing(size_t sample_rate = 1);
+	const FrameTracer* get_tracer() const;
+
 private:
 	std::vector<std::unique_ptr<char[]>> data;
 	std::deque<void*> ready;
@@ -31,5 +39,8 @@ private:
 	std::mutex mutex_ready{};
 	std::mutex mutex_free{};
 
+	std::unique_ptr<FrameTracer> tracer;
+
 	bool is_ready(void* ptr);
+	size_t index_of(void* ptr);
 };
\ No newline at end of file
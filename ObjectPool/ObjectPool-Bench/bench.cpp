@@ -0,0 +1,92 @@
+#include <map>
+#include <list>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iostream>
+#include "../ObjectPool/PoolAllocator.hpp"
+
+using namespace std::chrono;
+
+/* insert and erase workloads, std::allocator against PoolAllocator */
+
+static const size_t num_elems = 200000;
+static const size_t num_rounds = 10;
+
+template<typename F>
+double measure(F&& f)
+{
+	auto start = steady_clock::now();
+	for (size_t r = 0; r < num_rounds; ++r)
+	{
+		f();
+	}
+	return duration<double, std::milli>(steady_clock::now() - start).count() / num_rounds;
+}
+
+template<typename List>
+void list_workload()
+{
+	List list;
+	for (size_t i = 0; i < num_elems; ++i)
+	{
+		list.push_back(static_cast<int>(i));
+	}
+	// erase every other element and insert them again
+	for (auto it = list.begin(); it != list.end();)
+	{
+		it = list.erase(it);
+		if (it != list.end())
+		{
+			++it;
+		}
+	}
+	for (size_t i = 0; i < num_elems / 2; ++i)
+	{
+		list.push_front(static_cast<int>(i));
+	}
+}
+
+template<typename Map>
+void map_workload(const std::vector<int>& keys)
+{
+	Map map;
+	for (int key : keys)
+	{
+		map.emplace(key, key);
+	}
+	for (size_t i = 0; i < keys.size(); i += 2)
+	{
+		map.erase(keys[i]);
+	}
+	for (size_t i = 0; i < keys.size(); i += 2)
+	{
+		map.emplace(keys[i], 0);
+	}
+}
+
+void report(const char* name, double std_ms, double pool_ms)
+{
+	std::cout << name << ":\tstd::allocator " << std_ms << " ms,\tPoolAllocator " << pool_ms
+		<< " ms,\tspeedup " << std_ms / pool_ms << std::endl;
+}
+
+int main()
+{
+	report("std::list", measure(list_workload<std::list<int>>),
+		measure(list_workload<std::list<int, PoolAllocator<int>>>));
+
+	std::vector<int> keys(num_elems);
+	std::mt19937 gen(42);
+	for (int& key : keys)
+	{
+		key = static_cast<int>(gen());
+	}
+
+	using StdMap = std::map<int, int>;
+	using PoolMap = std::map<int, int, std::less<int>, PoolAllocator<std::pair<const int, int>>>;
+	report("std::map", measure([&]() { map_workload<StdMap>(keys); }),
+		measure([&]() { map_workload<PoolMap>(keys); }));
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <utility>
+#include <iostream>
+#include <coroutine>
+#include "../ObjectPool/FramePool.hpp"
+
+/* coroutine frames from global new against frames from the FramePool
+   g++ -std=c++20 -O2 -pthread coroutine.cpp -o coroutine && ./coroutine */
+
+using namespace std::chrono;
+
+static std::atomic<size_t> global_allocations{};
+
+void* operator new(size_t bytes)
+{
+	global_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(bytes > 0 ? bytes : 1))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+struct PlainFrame
+{
+};
+
+/* lazily started task, awaiting it resumes the awaiter when it is done */
+
+template<typename Frame>
+class Task
+{
+public:
+	struct promise_type : Frame
+	{
+		int value{};
+		std::coroutine_handle<> continuation;
+
+		Task get_return_object()
+		{
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		auto final_suspend() noexcept
+		{
+			struct Resume
+			{
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					return handle.promise().continuation ? handle.promise().continuation : std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+			return Resume{};
+		}
+
+		void return_value(int _value) { value = _value; }
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+	~Task()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	bool await_ready() noexcept { return false; }
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+	{
+		handle.promise().continuation = awaiter;
+		return handle;
+	}
+
+	int await_resume() noexcept { return handle.promise().value; }
+
+	int run()
+	{
+		handle.resume();
+		return handle.promise().value;
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit Task(std::coroutine_handle<promise_type> _handle) : handle(_handle) {}
+};
+
+template<typename Frame>
+Task<Frame> leaf(int i)
+{
+	co_return i & 7;
+}
+
+template<typename Frame>
+Task<Frame> request(int calls)
+{
+	int sum = 0;
+	for (int i = 0; i < calls; ++i)
+	{
+		sum += co_await leaf<Frame>(i);
+	}
+	co_return sum;
+}
+
+template<typename Frame>
+void measure(const char* name, int requests, int calls)
+{
+	request<Frame>(calls).run();	// warms up the pool
+
+	size_t allocations = global_allocations.load();
+	auto start = steady_clock::now();
+	int sum = 0;
+	for (int r = 0; r < requests; ++r)
+	{
+		sum += request<Frame>(calls).run();
+	}
+	double ns = duration<double, std::nano>(steady_clock::now() - start).count();
+	double awaited = static_cast<double>(requests) * calls;
+
+	std::cout << name << ":\t" << (global_allocations.load() - allocations) / awaited << " allocations and "
+		<< ns / awaited << " ns per awaited call (" << sum << ")" << std::endl;
+}
+
+int main()
+{
+	static const int requests = 100000;
+	static const int calls = 20;
+
+	measure<PlainFrame>("global new", requests, calls);
+	measure<PooledFrame>("FramePool", requests, calls);
+	return 0;
+}
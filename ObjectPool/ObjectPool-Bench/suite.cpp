@@ -0,0 +1,353 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <memory_resource>
+#include "../ObjectPool/ObjectPool.hpp"
+#include "../ObjectPool/ConcurrentObjectPool.hpp"
+#include "../ObjectPool/CachedObjectPool.hpp"
+
+/* Allocator benchmark suite, prints JSON to stdout.
+   g++ -std=c++20 -O2 -pthread suite.cpp -o suite && ./suite [--quick] [--max-threads N] > results.json
+   thread counts double from 1 up to --max-threads, hardware_concurrency by default
+
+   throughput     alloc a batch, touch it, free it in random order; ns per alloc + free
+   fragmentation  free a random half of the live objects and allocate it again;
+                  ns per alloc + free and how far the live objects are spread afterwards
+   iteration      read every live object after the churn above; ns per object */
+
+using namespace std::chrono;
+
+template<size_t Size>
+struct Object
+{
+	uint64_t words[Size / sizeof(uint64_t)];
+};
+
+/* allocators under test, every one hands out default-constructed objects */
+
+template<typename T>
+struct NewDelete
+{
+	static constexpr const char* name = "operator new";
+	static constexpr bool shared = true;
+
+	NewDelete(size_t) {}
+	T* alloc() { return new T; }
+	void free(T* ptr) { delete ptr; }
+};
+
+template<typename T>
+struct Pool
+{
+	static constexpr const char* name = "ObjectPool";
+	static constexpr bool shared = false;
+
+	ObjectPool<T> pool;
+
+	Pool(size_t capacity) : pool(capacity) {}
+	T* alloc() { return &pool.alloc(); }
+	void free(T* ptr) { pool.free(*ptr); }
+
+	template<typename F>
+	void for_each(const std::vector<T*>&, F&& f)
+	{
+		pool.for_each_live(f);
+	}
+};
+
+template<typename T>
+struct ConcurrentPool
+{
+	static constexpr const char* name = "ConcurrentObjectPool";
+	static constexpr bool shared = true;
+
+	ConcurrentObjectPool<T> pool;
+
+	ConcurrentPool(size_t capacity) : pool(capacity) {}
+	T* alloc() { return &pool.alloc(); }
+	void free(T* ptr) { pool.free(*ptr); }
+};
+
+// per-thread caches of free slots over a shared pool, like the thread-local free lists of mimalloc
+template<typename T>
+struct CachedPool
+{
+	static constexpr const char* name = "CachedObjectPool";
+	static constexpr bool shared = true;
+
+	CachedObjectPool<T> pool;
+
+	CachedPool(size_t capacity) : pool(capacity) {}
+	T* alloc() { return &pool.alloc(); }
+	void free(T* ptr) { pool.free(*ptr); }
+};
+
+template<typename T, typename Resource>
+struct PmrPool
+{
+	Resource resource;
+
+	PmrPool(size_t) {}
+	T* alloc() { return new(resource.allocate(sizeof(T), alignof(T))) T; }
+	void free(T* ptr)
+	{
+		ptr->~T();
+		resource.deallocate(ptr, sizeof(T), alignof(T));
+	}
+};
+
+template<typename T>
+struct UnsynchronizedPmr : PmrPool<T, std::pmr::unsynchronized_pool_resource>
+{
+	static constexpr const char* name = "unsynchronized_pool_resource";
+	static constexpr bool shared = false;
+
+	using PmrPool<T, std::pmr::unsynchronized_pool_resource>::PmrPool;
+};
+
+template<typename T>
+struct SynchronizedPmr : PmrPool<T, std::pmr::synchronized_pool_resource>
+{
+	static constexpr const char* name = "synchronized_pool_resource";
+	static constexpr bool shared = true;
+
+	using PmrPool<T, std::pmr::synchronized_pool_resource>::PmrPool;
+};
+
+// iteration through the pointers kept by the caller, unless the allocator can do better
+template<typename A, typename T, typename F>
+void for_each_object(A& allocator, const std::vector<T*>& objects, F&& f)
+{
+	if constexpr (requires { allocator.for_each(objects, f); })
+	{
+		allocator.for_each(objects, f);
+	}
+	else
+	{
+		for (T* object : objects)
+		{
+			f(*object);
+		}
+	}
+}
+
+/* results */
+
+struct Result
+{
+	std::string workload;
+	std::string allocator;
+	size_t object_size{};
+	size_t live_objects{};
+	size_t threads{};
+	double ns_per_op{};
+	double spread{};	// address range of the live objects divided by their total size, 0 if not measured
+};
+
+static std::vector<Result> results;
+static volatile uint64_t sink;	// keeps the reads of the iteration benchmark
+
+double elapsed_ns(steady_clock::time_point start)
+{
+	return duration<double, std::nano>(steady_clock::now() - start).count();
+}
+
+/* workloads */
+
+template<template<typename> class A, size_t Size>
+void throughput(size_t live_objects, size_t threads, size_t total_ops)
+{
+	using T = Object<Size>;
+	size_t batch = std::max<size_t>(live_objects / threads, 1);
+	size_t rounds = std::max<size_t>(total_ops / threads / batch, 1);
+
+	// shared allocators serve every thread, the others are created per thread;
+	// twice the live objects leaves room for the slots parked in per-thread caches
+	std::unique_ptr<A<T>> common;
+	if constexpr (A<T>::shared)
+	{
+		common = std::make_unique<A<T>>(2 * batch * threads);
+	}
+
+	auto run = [&](size_t seed)
+	{
+		std::unique_ptr<A<T>> own;
+		if constexpr (!A<T>::shared)
+		{
+			own = std::make_unique<A<T>>(batch);
+		}
+		A<T>& allocator = common ? *common : *own;
+
+		std::vector<size_t> order(batch);
+		for (size_t i = 0; i < batch; ++i)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937(static_cast<unsigned>(seed)));
+
+		std::vector<T*> objects(batch);
+		for (size_t r = 0; r < rounds; ++r)
+		{
+			for (size_t i = 0; i < batch; ++i)
+			{
+				objects[i] = allocator.alloc();
+				objects[i]->words[0] = i;
+			}
+			for (size_t i : order)
+			{
+				allocator.free(objects[i]);
+			}
+		}
+	};
+
+	auto start = steady_clock::now();
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t)
+	{
+		workers.emplace_back(run, t);
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	double ns = elapsed_ns(start);
+
+	results.push_back({ "throughput", A<T>::name, Size, batch * threads, threads, ns / (rounds * batch) });
+}
+
+template<template<typename> class A, size_t Size>
+void fragmentation_and_iteration(size_t live_objects, size_t churn_rounds)
+{
+	using T = Object<Size>;
+	A<T> allocator(live_objects);
+	std::mt19937 gen(42);
+
+	std::vector<T*> objects(live_objects);
+	for (size_t i = 0; i < live_objects; ++i)
+	{
+		objects[i] = allocator.alloc();
+		objects[i]->words[0] = i;
+	}
+
+	// free a random half and allocate it again, the live set ends up scattered
+	auto start = steady_clock::now();
+	for (size_t r = 0; r < churn_rounds; ++r)
+	{
+		std::shuffle(objects.begin(), objects.end(), gen);
+		for (size_t i = 0; i < live_objects / 2; ++i)
+		{
+			allocator.free(objects[i]);
+		}
+		for (size_t i = 0; i < live_objects / 2; ++i)
+		{
+			objects[i] = allocator.alloc();
+			objects[i]->words[0] = i;
+		}
+	}
+	double churn_ns = elapsed_ns(start) / (churn_rounds * (live_objects / 2));
+
+	auto [low, high] = std::minmax_element(objects.begin(), objects.end(), std::less<T*>());
+	double span = static_cast<double>(reinterpret_cast<char*>(*high) - reinterpret_cast<char*>(*low) + sizeof(T));
+	results.push_back({ "fragmentation", A<T>::name, Size, live_objects, 1, churn_ns, span / (live_objects * sizeof(T)) });
+
+	static const size_t passes = 5;
+	uint64_t sum = 0;
+	start = steady_clock::now();
+	for (size_t p = 0; p < passes; ++p)
+	{
+		for_each_object(allocator, objects, [&](T& object) { sum += object.words[0]; });
+	}
+	sink = sum;
+	results.push_back({ "iteration", A<T>::name, Size, live_objects, 1, elapsed_ns(start) / (passes * live_objects) });
+
+	for (T* object : objects)
+	{
+		allocator.free(object);
+	}
+}
+
+template<size_t Size>
+void run_size(const std::vector<size_t>& live_counts, const std::vector<size_t>& thread_counts, size_t total_ops, size_t churn_rounds)
+{
+	for (size_t live : live_counts)
+	{
+		for (size_t threads : thread_counts)
+		{
+			throughput<NewDelete, Size>(live, threads, total_ops);
+			throughput<Pool, Size>(live, threads, total_ops);
+			throughput<ConcurrentPool, Size>(live, threads, total_ops);
+			throughput<CachedPool, Size>(live, threads, total_ops);
+			throughput<UnsynchronizedPmr, Size>(live, threads, total_ops);
+			throughput<SynchronizedPmr, Size>(live, threads, total_ops);
+		}
+
+		fragmentation_and_iteration<NewDelete, Size>(live, churn_rounds);
+		fragmentation_and_iteration<Pool, Size>(live, churn_rounds);
+		fragmentation_and_iteration<ConcurrentPool, Size>(live, churn_rounds);
+		fragmentation_and_iteration<UnsynchronizedPmr, Size>(live, churn_rounds);
+		fragmentation_and_iteration<SynchronizedPmr, Size>(live, churn_rounds);
+	}
+}
+
+void print_json(std::ostream& os)
+{
+	os << "{\n  \"context\": { \"hardware_concurrency\": " << std::thread::hardware_concurrency() << " },\n";
+	os << "  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		os << "    { \"workload\": \"" << r.workload << "\", \"allocator\": \"" << r.allocator
+			<< "\", \"object_size\": " << r.object_size << ", \"live_objects\": " << r.live_objects
+			<< ", \"threads\": " << r.threads << ", \"ns_per_op\": " << r.ns_per_op;
+		if (r.spread != 0)
+		{
+			os << ", \"spread\": " << r.spread;
+		}
+		os << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	os << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = false;
+	size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--quick") == 0)
+		{
+			quick = true;
+		}
+		else if (std::strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc)
+		{
+			max_threads = std::max(std::stoul(argv[++i]), 1ul);
+		}
+	}
+
+	std::vector<size_t> live_counts = quick ? std::vector<size_t>{ 1 << 10, 1 << 14 } : std::vector<size_t>{ 1 << 10, 1 << 14, 1 << 18 };
+	std::vector<size_t> thread_counts;
+	for (size_t threads = 1; threads <= max_threads; threads *= 2)
+	{
+		thread_counts.push_back(threads);
+	}
+	// the machine's own thread count is measured even if it is no power of two
+	if (thread_counts.back() < max_threads)
+	{
+		thread_counts.push_back(max_threads);
+	}
+	size_t total_ops = quick ? 1 << 18 : 1 << 21;
+	size_t churn_rounds = quick ? 2 : 8;
+
+	run_size<16>(live_counts, thread_counts, total_ops, churn_rounds);
+	run_size<64>(live_counts, thread_counts, total_ops, churn_rounds);
+	run_size<256>(live_counts, thread_counts, total_ops, churn_rounds);
+
+	print_json(std::cout);
+	return 0;
+}
@@ -1,6 +1,24 @@
 #include "gtest/gtest.h"
 #include "memleak_global/gtest-memleak.h"
 #include "../ObjectPool/ObjectPool.hpp"
+#include "../ObjectPool/ConcurrentObjectPool.hpp"
+#include "../ObjectPool/CachedObjectPool.hpp"
+#include "../ObjectPool/PoolAllocator.hpp"
+#include "../ObjectPool/PoolResource.hpp"
+#include "../ObjectPool/SoAPool.hpp"
+#include "../ObjectPool/EpochObjectPool.hpp"
+#include "../ObjectPool/NumaObjectPool.hpp"
+#include "../ObjectPool/FramePool.hpp"
+
+#include <map>
+#include <set>
+#include <list>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <coroutine>
+#include <algorithm>
 
 class Point
 {
@@ -280,4 +298,1911 @@ TEST(Free, PseudorandomOrder)
 	{
 		EXPECT_NO_THROW(pool.free(objects[20 - 2 * i - 1]));
 	}
-}
\ No newline at end of file
+}
+
+TEST(FreeList, TryAllocWhenFull)
+{
+	ObjectPool<Point> pp(2);
+	EXPECT_NE(pp.try_alloc(), nullptr);
+	EXPECT_NE(pp.try_alloc(1, 2), nullptr);
+	EXPECT_EQ(pp.try_alloc(), nullptr);
+	EXPECT_EQ(pp.num_free(), 0);
+}
+
+TEST(FreeList, ReusesLastFreedSlot)
+{
+	ObjectPool<Point> pp(10);
+	Point& point1 = pp.alloc();
+	Point& point2 = pp.alloc(1, 1);
+	Point* address = &point1;
+	pp.free(point1);
+	Point& point3 = pp.alloc(2, 2);
+	EXPECT_EQ(&point3, address);
+	EXPECT_EQ(point3.get_x(), 2);
+	EXPECT_EQ(point2.get_x(), 1);
+}
+
+TEST(FreeList, SmallerThanIndex)
+{
+	ObjectPool<char> pool(3);
+	char& c1 = pool.alloc('a');
+	char& c2 = pool.alloc('b');
+	char& c3 = pool.alloc('c');
+	pool.free(c2);
+	EXPECT_EQ(c1, 'a');
+	EXPECT_EQ(c3, 'c');
+	EXPECT_EQ(pool.alloc('d'), 'd');
+	EXPECT_THROW(pool.alloc(), std::out_of_range);
+}
+
+TEST(FreeList, ManyObjects)
+{
+	static const size_t size = 100000;
+	ObjectPool<P> pool(size);
+	std::vector<P*> objects;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		objects.push_back(&pool.alloc(static_cast<int>(i), 0.0));
+	}
+	EXPECT_EQ(pool.try_alloc(), nullptr);
+
+	for (size_t i = 0; i < size; i += 2)
+	{
+		pool.free(*objects[i]);
+	}
+	for (size_t i = 0; i < size; i += 2)
+	{
+		objects[i] = &pool.alloc(static_cast<int>(i), 0.0);
+	}
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		EXPECT_EQ(objects[i]->i, static_cast<int>(i));
+	}
+}
+
+TEST(LiveObjects, EmptyPool)
+{
+	ObjectPool<Point> pp(100);
+	size_t count = 0;
+	pp.for_each_live([&](Point&) { ++count; });
+	EXPECT_EQ(count, 0);
+	EXPECT_TRUE(pp.begin() == pp.end());
+}
+
+TEST(LiveObjects, ForEachLive)
+{
+	ObjectPool<Point> pp(200);
+	std::vector<Point*> points;
+	for (int i = 0; i < 200; ++i)
+	{
+		points.push_back(&pp.alloc(i, -i));
+	}
+	for (int i = 0; i < 200; ++i)
+	{
+		if (i % 3 != 0)
+		{
+			pp.free(*points[i]);
+		}
+	}
+
+	int sum = 0;
+	size_t count = 0;
+	pp.for_each_live([&](Point& point)
+	{
+		sum += point.get_x();
+		++count;
+	});
+	EXPECT_EQ(count, 67);
+	EXPECT_EQ(sum, 3 * (66 * 67 / 2));
+	EXPECT_EQ(pp.num_free(), 200 - 67);
+}
+
+TEST(LiveObjects, Iterator)
+{
+	ObjectPool<Point> pp(1000);
+	std::vector<Point*> points;
+	for (int i = 0; i < 1000; ++i)
+	{
+		points.push_back(&pp.alloc(i, i));
+	}
+	for (int i = 0; i < 1000; ++i)
+	{
+		if (i != 5 && i != 64 && i != 999)
+		{
+			pp.free(*points[i]);
+		}
+	}
+
+	std::vector<int> xs;
+	for (Point& point : pp)
+	{
+		xs.push_back(point.get_x());
+	}
+	EXPECT_EQ(xs, std::vector<int>({ 5, 64, 999 }));
+	EXPECT_EQ(std::distance(pp.begin(), pp.end()), 3);
+}
+
+TEST(Growable, NeverFull)
+{
+	ObjectPool<Point> pp(2, { .growable = true });
+	std::vector<Point*> points;
+	for (int i = 0; i < 100; ++i)
+	{
+		EXPECT_NO_THROW(points.push_back(&pp.alloc(i, i)));
+	}
+	EXPECT_EQ(pp.capacity(), 2 + 4 + 8 + 16 + 32 + 64);
+	EXPECT_EQ(pp.num_free(), pp.capacity() - 100);
+
+	// objects are never moved when the pool grows
+	for (int i = 0; i < 100; ++i)
+	{
+		EXPECT_EQ(points[i]->get_x(), i);
+	}
+}
+
+TEST(Growable, FreeFromEveryChunk)
+{
+	ObjectPool<P> pool(3, { .growable = true });
+	std::vector<P*> objects;
+	for (int i = 0; i < 50; ++i)
+	{
+		objects.push_back(&pool.alloc(i, 0.0));
+	}
+
+	size_t capacity = pool.capacity();
+	for (int i = 49; i >= 0; --i)
+	{
+		EXPECT_NO_THROW(pool.free(*objects[i]));
+	}
+	EXPECT_EQ(pool.num_free(), capacity);
+
+	P p{};
+	EXPECT_THROW(pool.free(p), std::out_of_range);
+	EXPECT_THROW(pool.free(*objects[10]), std::out_of_range);
+
+	for (int i = 0; i < 50; ++i)
+	{
+		pool.alloc();
+	}
+	EXPECT_EQ(pool.capacity(), capacity);
+}
+
+TEST(Growable, ZeroSize)
+{
+	ObjectPool<Point> pp(0, { .growable = true });
+	Point& point = pp.alloc(1, 2);
+	EXPECT_EQ(point.get_y(), 2);
+
+	ObjectPool<Point> fixed(0);
+	EXPECT_THROW(fixed.alloc(), std::out_of_range);
+}
+
+TEST(Growable, IterateAcrossChunks)
+{
+	ObjectPool<Point> pp(1, { .growable = true });
+	for (int i = 0; i < 10; ++i)
+	{
+		pp.alloc(i, i);
+	}
+	int sum = 0;
+	for (Point& point : pp)
+	{
+		sum += point.get_x();
+	}
+	EXPECT_EQ(sum, 45);
+}
+
+
+TEST(Concurrent, SingleThread)
+{
+	ConcurrentObjectPool<Point> pp(2);
+	Point& point1 = pp.alloc(1, 2);
+	Point& point2 = pp.alloc();
+	EXPECT_EQ(pp.try_alloc(), nullptr);
+	EXPECT_THROW(pp.alloc(), std::out_of_range);
+	EXPECT_EQ(point1.get_y(), 2);
+
+	pp.free(point2);
+	EXPECT_THROW(pp.free(point2), std::out_of_range);
+	Point point3;
+	EXPECT_THROW(pp.free(point3), std::out_of_range);
+	EXPECT_EQ(pp.num_free(), 1);
+}
+
+// ObjectPool behind a mutex, the baseline for ConcurrentObjectPool
+template<typename T>
+class MutexObjectPool
+{
+public:
+	MutexObjectPool(size_t size) : pool(size) {}
+
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		return pool.try_alloc(std::forward<Args>(args)...);
+	}
+
+	void free(T& object)
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		pool.free(object);
+	}
+
+	size_t num_free()
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		return pool.num_free();
+	}
+
+private:
+	ObjectPool<T> pool;
+	std::mutex mutex;
+};
+
+// every thread repeatedly takes a batch of objects, checks nobody else touched them and frees them
+template<typename Pool>
+bool stress(Pool& pool, size_t num_threads, size_t batch, size_t rounds)
+{
+	std::atomic<bool> ok{ true };
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			std::vector<P*> objects;
+			for (size_t r = 0; r < rounds; ++r)
+			{
+				for (size_t i = 0; i < batch; ++i)
+				{
+					P* p = pool.try_alloc(static_cast<int>(t), static_cast<double>(i));
+					if (p != nullptr)
+					{
+						objects.push_back(p);
+					}
+				}
+				for (size_t i = 0; i < objects.size(); ++i)
+				{
+					if (objects[i]->i != static_cast<int>(t))
+					{
+						ok = false;
+					}
+					pool.free(*objects[i]);
+				}
+				objects.clear();
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	return ok;
+}
+
+TEST(Concurrent, StressAgainstMutexPool)
+{
+	static const size_t num_threads = 8;
+	static const size_t batch = 64;
+	static const size_t rounds = 2000;
+	static const size_t size = num_threads * batch / 2;	// some allocations fail on purpose
+
+	ConcurrentObjectPool<P> lock_free(size);
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_TRUE(stress(lock_free, num_threads, batch, rounds));
+	auto lock_free_time = std::chrono::steady_clock::now() - start;
+	EXPECT_EQ(lock_free.num_free(), size);
+
+	MutexObjectPool<P> locked(size);
+	start = std::chrono::steady_clock::now();
+	EXPECT_TRUE(stress(locked, num_threads, batch, rounds));
+	auto locked_time = std::chrono::steady_clock::now() - start;
+	EXPECT_EQ(locked.num_free(), size);
+
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	RecordProperty("lock_free_us", static_cast<int>(duration_cast<microseconds>(lock_free_time).count()));
+	RecordProperty("mutex_us", static_cast<int>(duration_cast<microseconds>(locked_time).count()));
+}
+
+
+TEST(Cached, SingleThread)
+{
+	CachedObjectPool<Point> pp(10, 4);
+	std::vector<Point*> points;
+	for (int i = 0; i < 10; ++i)
+	{
+		points.push_back(&pp.alloc(i, i));
+	}
+	EXPECT_EQ(pp.try_alloc(), nullptr);
+	EXPECT_THROW(pp.alloc(), std::out_of_range);
+
+	Point point;
+	EXPECT_THROW(pp.free(point), std::out_of_range);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		EXPECT_EQ(points[i]->get_x(), i);
+		pp.free(*points[i]);
+	}
+	for (int i = 0; i < 10; ++i)
+	{
+		EXPECT_NO_THROW(pp.alloc());
+	}
+}
+
+TEST(Cached, FreedOnOtherThread)
+{
+	static const size_t size = 256;
+	CachedObjectPool<P> pool(size, 8);
+	std::vector<P*> objects(size);
+
+	std::thread producer([&]()
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			objects[i] = &pool.alloc(static_cast<int>(i), 0.0);
+		}
+	});
+	producer.join();
+
+	std::thread consumer([&]()
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			EXPECT_EQ(objects[i]->i, static_cast<int>(i));
+			pool.free(*objects[i]);
+		}
+	});
+	consumer.join();
+
+	// the consumer's cache went back to the shared pool when the thread exited
+	for (size_t i = 0; i < size; ++i)
+	{
+		EXPECT_NO_THROW(objects[i] = &pool.alloc());
+	}
+	for (size_t i = 0; i < size; ++i)
+	{
+		pool.free(*objects[i]);
+	}
+}
+
+TEST(Cached, DoubleFree)
+{
+	CachedObjectPool<Point> pp(10, 4);
+	Point& a = pp.alloc(1, 1);
+	Point& b = pp.alloc(2, 2);
+	pp.free(a);
+	EXPECT_THROW(pp.free(a), std::out_of_range);
+
+	// the batch was taken from the start of the pool, the slot below b's is still in this thread's cache
+	Point* cached = &b - 1;
+	EXPECT_THROW(pp.free(*cached), std::out_of_range);
+
+	Point& c = pp.alloc(3, 3);
+	Point& d = pp.alloc(4, 4);
+	EXPECT_NE(&c, &d);
+	pp.free(b);
+	pp.free(c);
+	pp.free(d);
+}
+
+TEST(Cached, Stress)
+{
+	static const size_t num_threads = 8;
+	CachedObjectPool<P> pool(num_threads * 64, 16);
+	EXPECT_TRUE(stress(pool, num_threads, 32, 2000));
+}
+
+struct Tally
+{
+	static int alive;
+	Tally() { ++alive; }
+	~Tally() { --alive; }
+};
+
+int Tally::alive = 0;
+
+TEST(Cached, DestroysLiveObjects)
+{
+	std::atomic<int> step{};
+	std::thread other;
+	{
+		CachedObjectPool<Tally> pool(64, 4);
+		pool.alloc();
+		Tally& freed = pool.alloc();
+		pool.free(freed);
+
+		// another thread keeps slots of the pool in its cache
+		other = std::thread([&]
+		{
+			pool.free(pool.alloc());
+			pool.alloc();
+			step = 1;
+			while (step != 2)
+			{
+				std::this_thread::yield();
+			}
+
+			// the cache of the destroyed pool is dropped, a new pool gets a new one
+			CachedObjectPool<Tally> next(8, 4);
+			next.free(next.alloc());
+		});
+		while (step != 1)
+		{
+			std::this_thread::yield();
+		}
+		EXPECT_EQ(Tally::alive, 2);
+	}
+	EXPECT_EQ(Tally::alive, 0);
+	step = 2;
+	other.join();
+	EXPECT_EQ(Tally::alive, 0);
+}
+
+struct alignas(64) Aligned
+{
+	float v[4];
+};
+
+static bool is_aligned(const void* ptr, size_t alignment)
+{
+	return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+TEST(Alignment, OverAlignedType)
+{
+	ObjectPool<Aligned> pool(20, { .growable = true });
+	for (int i = 0; i < 100; ++i)
+	{
+		EXPECT_TRUE(is_aligned(&pool.alloc(), 64));
+	}
+
+	ConcurrentObjectPool<Aligned> concurrent(10);
+	for (int i = 0; i < 10; ++i)
+	{
+		EXPECT_TRUE(is_aligned(&concurrent.alloc(), 64));
+	}
+}
+
+TEST(Alignment, RequestedAlignment)
+{
+	ObjectPool<Point> pp(10, { .alignment = 32 });
+	Point& point1 = pp.alloc(1, 1);
+	Point& point2 = pp.alloc(2, 2);
+	EXPECT_TRUE(is_aligned(&point1, 32));
+	EXPECT_TRUE(is_aligned(&point2, 32));
+	EXPECT_NO_THROW(pp.free(point1));
+	EXPECT_EQ(point2.get_x(), 2);
+
+	EXPECT_THROW(ObjectPool<Point>(10, { .alignment = 24 }), std::invalid_argument);
+}
+
+TEST(Alignment, CacheLinePadding)
+{
+	ObjectPool<int> pool(10, { .cache_line_padding = true });
+	int* a = &pool.alloc(1);
+	int* b = &pool.alloc(2);
+	EXPECT_TRUE(is_aligned(a, cache_line_size));
+	EXPECT_TRUE(is_aligned(b, cache_line_size));
+	EXPECT_NE(reinterpret_cast<uintptr_t>(a) / cache_line_size, reinterpret_cast<uintptr_t>(b) / cache_line_size);
+
+	ConcurrentObjectPool<int> concurrent(10, { .cache_line_padding = true });
+	a = &concurrent.alloc(1);
+	b = &concurrent.alloc(2);
+	EXPECT_TRUE(is_aligned(a, cache_line_size));
+	EXPECT_TRUE(is_aligned(b, cache_line_size));
+	EXPECT_NO_THROW(concurrent.free(*a));
+	EXPECT_NO_THROW(concurrent.free(*b));
+}
+
+
+TEST(Allocator, List)
+{
+	std::list<int, PoolAllocator<int>> list;
+	for (int i = 0; i < 1000; ++i)
+	{
+		list.push_back(i);
+	}
+	list.remove_if([](int i) { return i % 2 == 0; });
+	for (int i = 0; i < 500; ++i)
+	{
+		list.push_front(-i);
+	}
+	EXPECT_EQ(list.size(), 1000);
+	EXPECT_EQ(list.back(), 999);
+
+	std::list<int, PoolAllocator<int>> moved(std::move(list));
+	EXPECT_EQ(moved.size(), 1000);
+	list.push_back(1);
+	EXPECT_EQ(list.size(), 1);
+}
+
+TEST(Allocator, Map)
+{
+	std::map<int, std::string, std::less<int>, PoolAllocator<std::pair<const int, std::string>>> map;
+	for (int i = 0; i < 1000; ++i)
+	{
+		map[i] = std::to_string(i);
+	}
+	for (int i = 0; i < 1000; i += 3)
+	{
+		map.erase(i);
+	}
+	EXPECT_EQ(map.size(), 666);
+	EXPECT_EQ(map.at(998), "998");
+
+	auto copy = map;
+	EXPECT_EQ(copy, map);
+	EXPECT_NE(copy.get_allocator(), map.get_allocator());
+}
+
+TEST(Allocator, ReusesNodes)
+{
+	std::list<Point, PoolAllocator<Point>> list;
+	list.emplace_back(1, 1);
+	const Point* first = &list.front();
+	list.pop_back();
+	list.emplace_back(2, 2);
+	EXPECT_EQ(&list.front(), first);
+}
+
+TEST(Allocator, Rebind)
+{
+	PoolAllocator<int> a;
+	PoolAllocator<double> b(a);
+	PoolAllocator<int> c;
+	EXPECT_TRUE(a == b);
+	EXPECT_FALSE(a == c);
+
+	double* d = b.allocate(1);
+	*d = 1.0;
+	b.deallocate(d, 1);
+
+	std::vector<int, PoolAllocator<int>> v(100, 1);	// arrays go to operator new
+	EXPECT_EQ(v.size(), 100);
+}
+
+
+TEST(Resource, SizeClasses)
+{
+	BasicPoolResource<8, 48, 64> resource;
+	void* a = resource.allocate(4, 4);
+	void* b = resource.allocate(40, 16);
+	void* c = resource.allocate(40, 32);	// 48 is only 16-aligned
+	void* d = resource.allocate(100, 8);	// too big for every class
+
+	EXPECT_TRUE(is_aligned(b, 16));
+	EXPECT_TRUE(is_aligned(c, 32));
+
+	std::vector<BasicPoolResource<8, 48, 64>::ClassStats> stats = resource.stats();
+	ASSERT_EQ(stats.size(), 3);
+	EXPECT_EQ(stats[0].size, 8);
+	EXPECT_EQ(stats[0].used, 1);
+	EXPECT_EQ(stats[1].used, 1);
+	EXPECT_EQ(stats[2].used, 1);
+	EXPECT_EQ(stats[2].allocations, 1);
+	EXPECT_EQ(resource.upstream_stats().used, 1);
+
+	resource.deallocate(a, 4, 4);
+	resource.deallocate(b, 40, 16);
+	resource.deallocate(c, 40, 32);
+	resource.deallocate(d, 100, 8);
+
+	stats = resource.stats();
+	for (const auto& s : stats)
+	{
+		EXPECT_EQ(s.used, 0);
+		EXPECT_GE(s.capacity, 1);
+	}
+	EXPECT_EQ(resource.upstream_stats().used, 0);
+	EXPECT_EQ(resource.upstream_stats().allocations, 1);
+}
+
+TEST(Resource, PmrContainers)
+{
+	PoolResource resource;
+	{
+		std::pmr::list<int> list(&resource);
+		std::pmr::map<int, std::pmr::string> map(&resource);
+		for (int i = 0; i < 1000; ++i)
+		{
+			list.push_back(i);
+			map.emplace(i, "a string that does not fit the small buffer");
+		}
+		for (int i = 0; i < 1000; i += 2)
+		{
+			map.erase(i);
+		}
+		EXPECT_EQ(map.size(), 500);
+		EXPECT_EQ(map.at(1), "a string that does not fit the small buffer");
+
+		size_t used = 0;
+		for (const PoolResource::ClassStats& s : resource.stats())
+		{
+			used += s.used;
+		}
+		EXPECT_EQ(used, 1000 + 500 + 500);
+	}
+
+	for (const PoolResource::ClassStats& s : resource.stats())
+	{
+		EXPECT_EQ(s.used, 0);
+	}
+}
+
+struct Ping
+{
+	uint32_t id;
+	uint32_t flags;
+};
+
+struct Pong
+{
+	double value;
+};
+
+struct Order
+{
+	uint64_t id;
+	double price;
+	uint32_t quantity;
+};
+
+struct Snapshot
+{
+	char data[2000];
+};
+
+TEST(Resource, TypedSharesSizeClasses)
+{
+	BasicPoolResource<8, 16, 32> resource;
+	static_assert(BasicPoolResource<8, 16, 32>::size_class<Ping>() == 8);
+	static_assert(BasicPoolResource<8, 16, 32>::size_class<Pong>() == 8);
+	static_assert(BasicPoolResource<8, 16, 32>::size_class<Order>() == 32);
+	static_assert(BasicPoolResource<8, 16, 32>::size_class<Snapshot>() == 0);
+
+	// two types of the same size class live in one slab
+	Ping& ping = resource.alloc<Ping>(1u, 2u);
+	Pong& pong = resource.alloc<Pong>(0.5);
+	Order& order = resource.alloc<Order>(7ull, 1.5, 3u);
+	Snapshot& snapshot = resource.alloc<Snapshot>();
+	EXPECT_EQ(ping.flags, 2);
+	EXPECT_EQ(pong.value, 0.5);
+	EXPECT_EQ(order.quantity, 3);
+
+	auto stats = resource.stats();
+	EXPECT_EQ(stats[0].used, 2);
+	EXPECT_EQ(stats[1].used, 0);
+	EXPECT_EQ(stats[2].used, 1);
+	EXPECT_EQ(resource.upstream_stats().used, 1);
+
+	resource.free(ping);
+	EXPECT_THROW(resource.free(ping), std::out_of_range);
+	Pong outside{};
+	EXPECT_THROW(resource.free(outside), std::out_of_range);
+
+	// the freed slot is reused by the other type
+	EXPECT_EQ(static_cast<void*>(&resource.alloc<Pong>(1.0)), static_cast<void*>(&ping));
+
+	resource.free(pong);
+	resource.free(order);
+	resource.free(snapshot);
+	EXPECT_EQ(resource.stats()[0].used, 1);
+	EXPECT_EQ(resource.stats()[0].allocations, 3);
+	EXPECT_EQ(resource.upstream_stats().used, 0);
+}
+
+struct Throwing
+{
+	uint64_t value;
+
+	Throwing()
+	{
+		throw std::runtime_error("no");
+	}
+};
+
+TEST(Resource, TypedConstructorThrows)
+{
+	PoolResource resource;
+	EXPECT_THROW(resource.alloc<Throwing>(), std::runtime_error);
+	for (const PoolResource::ClassStats& s : resource.stats())
+	{
+		EXPECT_EQ(s.used, 0);
+	}
+}
+
+TEST(Handle, GetAndFree)
+{
+	ObjectPool<Point> pp(10);
+	PoolHandle handle = pp.alloc_handle(1, 2);
+	ASSERT_NE(pp.get(handle), nullptr);
+	EXPECT_EQ(pp.get(handle)->get_y(), 2);
+	EXPECT_EQ(pp.handle_of(*pp.get(handle)), handle);
+	EXPECT_EQ(pp.num_free(), 9);
+
+	pp.free(handle);
+	EXPECT_EQ(pp.get(handle), nullptr);
+	EXPECT_THROW(pp.free(handle), std::out_of_range);
+	EXPECT_EQ(pp.num_free(), 10);
+	EXPECT_EQ(sizeof(PoolHandle), 4);
+}
+
+TEST(Handle, StaleAfterReuse)
+{
+	ObjectPool<Point> pp(1);
+	PoolHandle old_handle = pp.alloc_handle(1, 1);
+	pp.free(*pp.get(old_handle));	// freeing by reference invalidates handles too
+
+	PoolHandle new_handle = pp.alloc_handle(2, 2);
+	EXPECT_EQ(old_handle.index(), new_handle.index());
+	EXPECT_EQ(pp.get(old_handle), nullptr);
+	EXPECT_THROW(pp.free(old_handle), std::out_of_range);
+	EXPECT_EQ(pp.get(new_handle)->get_x(), 2);
+}
+
+TEST(Handle, StaleWhileSlotChurns)
+{
+	ObjectPool<Point> pp(4);
+	PoolHandle first = pp.alloc_handle(1, 1);
+	pp.free(first);
+
+	// the free list gives the same slot back every time
+	for (int i = 0; i < 256; ++i)
+	{
+		PoolHandle handle = pp.alloc_handle(2, 2);
+		EXPECT_EQ(handle.index(), first.index());
+		EXPECT_EQ(pp.get(first), nullptr);
+		pp.free(handle);
+	}
+	EXPECT_EQ(pp.get(first), nullptr);
+	EXPECT_THROW(pp.free(first), std::out_of_range);
+}
+
+TEST(Handle, GenerationWraps)
+{
+	ObjectPool<Point> pp(1);
+	PoolHandle first = pp.alloc_handle(1, 1);
+	pp.free(first);
+
+	// the generation has generation_bits bits, the slot's handle comes back after that many reuses
+	PoolHandle handle;
+	for (uint32_t i = 0; i < PoolHandle::generation_mask; ++i)
+	{
+		handle = pp.alloc_handle(2, 2);
+		EXPECT_NE(handle, first);
+		pp.free(handle);
+	}
+	EXPECT_EQ(pp.alloc_handle(3, 3), first);
+	EXPECT_EQ(first.index(), 0);
+	EXPECT_LT(first.generation(), 1u << PoolHandle::generation_bits);
+}
+
+TEST(Handle, InvalidHandles)
+{
+	ObjectPool<Point> pp(10);
+	EXPECT_EQ(pp.get(PoolHandle{}), nullptr);
+	EXPECT_EQ(pp.get(PoolHandle{ 5, 0 }), nullptr);	// never allocated
+	EXPECT_EQ(pp.get(PoolHandle{ 100, 0 }), nullptr);
+
+	Point point;
+	EXPECT_THROW(pp.handle_of(point), std::out_of_range);
+	for (int i = 0; i < 10; ++i)
+	{
+		pp.alloc_handle();
+	}
+	EXPECT_THROW(pp.alloc_handle(), std::out_of_range);
+}
+
+TEST(Bulk, AllocN)
+{
+	ObjectPool<Point> pp(100);
+	std::vector<Point*> points = pp.alloc_n(70, 3, 4);
+	ASSERT_EQ(points.size(), 70);
+	for (Point* point : points)
+	{
+		EXPECT_EQ(point->get_x(), 3);
+		EXPECT_EQ(point->get_y(), 4);
+	}
+	EXPECT_EQ(pp.num_free(), 30);
+	EXPECT_THROW(pp.alloc_n(31), std::out_of_range);
+	EXPECT_EQ(pp.num_free(), 30);
+
+	// reuses freed slots first, then the untouched tail
+	pp.free_n(std::span<Point* const>(points.data(), 20));
+	std::vector<Point*> more = pp.alloc_n(50);
+	EXPECT_EQ(more.size(), 50);
+	EXPECT_EQ(pp.num_free(), 0);
+
+	size_t live = 0;
+	pp.for_each_live([&](Point&) { ++live; });
+	EXPECT_EQ(live, 100);
+}
+
+TEST(Bulk, TriviallyConstructible)
+{
+	ObjectPool<P> pool(200);
+	std::vector<P*> objects = pool.alloc_n(150);
+	for (P* p : objects)
+	{
+		EXPECT_EQ(p->i, 0);
+		EXPECT_EQ(p->d, 0.0);
+		p->i = 1;
+	}
+	pool.free_n(objects);
+	EXPECT_EQ(pool.num_free(), 200);
+
+	objects = pool.alloc_n(200);
+	for (P* p : objects)
+	{
+		EXPECT_EQ(p->i, 0);
+	}
+}
+
+TEST(Bulk, ReusesFreedRuns)
+{
+	ObjectPool<Point> pp(256);
+	std::vector<Point*> points = pp.alloc_n(128);
+	pp.free_n(points);
+
+	// freed slots come back as one run in address order, not in free list order
+	points = pp.alloc_n(128, 1, 1);
+	for (size_t k = 0; k < points.size(); ++k)
+	{
+		EXPECT_EQ(points[k], points[0] + k);
+		EXPECT_EQ(points[k]->get_x(), 1);
+	}
+}
+
+TEST(Bulk, FreedRunsSkipRecycledSlots)
+{
+	ObjectPool<Point> pp(64);
+	std::vector<Point*> points = pp.alloc_n(64, 1, 1);
+	for (size_t k = 0; k < 64; k += 2)
+	{
+		pp.free(*points[k]);
+	}
+	pp.release(*points[1]);
+	pp.release(*points[3]);
+
+	std::vector<Point*> more = pp.alloc_n(20, 2, 2);
+	EXPECT_EQ(pp.num_recycled(), 2);
+	for (Point* point : more)
+	{
+		EXPECT_NE(point, points[1]);
+		EXPECT_NE(point, points[3]);
+		EXPECT_EQ(point->get_x(), 2);
+	}
+
+	// the slots left on the free list are still linked, every remaining one is handed out once
+	std::set<Point*> rest;
+	while (Point* point = pp.try_alloc())
+	{
+		EXPECT_TRUE(rest.insert(point).second);
+	}
+	EXPECT_EQ(rest.size(), 14);
+	EXPECT_EQ(pp.num_free(), 0);
+}
+
+TEST(Bulk, Growable)
+{
+	ObjectPool<Point> pp(4, { .growable = true });
+	std::vector<Point*> points = pp.alloc_n(100, 1, 1);
+	EXPECT_EQ(points.size(), 100);
+	EXPECT_GE(pp.capacity(), 100);
+	pp.free_n(points);
+	EXPECT_EQ(pp.num_free(), pp.capacity());
+}
+
+TEST(Bulk, FreeNAllOrNothing)
+{
+	ObjectPool<Point> pp(10);
+	std::vector<Point*> points = pp.alloc_n(5);
+	Point outside;
+
+	std::vector<Point*> bad = { points[0], points[1], &outside };
+	EXPECT_THROW(pp.free_n(bad), std::out_of_range);
+	EXPECT_EQ(pp.num_free(), 5);
+
+	std::vector<Point*> twice = { points[2], points[2] };
+	EXPECT_THROW(pp.free_n(twice), std::out_of_range);
+	EXPECT_EQ(pp.num_free(), 5);
+
+	EXPECT_NO_THROW(pp.free_n(points));
+	EXPECT_EQ(pp.num_free(), 10);
+}
+
+struct ThrowingOnThird
+{
+	static int count;
+	ThrowingOnThird()
+	{
+		if (++count == 3)
+		{
+			throw std::runtime_error("third");
+		}
+	}
+};
+int ThrowingOnThird::count = 0;
+
+TEST(Bulk, ConstructorThrows)
+{
+	ObjectPool<ThrowingOnThird> pool(10);
+	EXPECT_THROW(pool.alloc_n(5), std::runtime_error);
+	EXPECT_EQ(pool.num_free(), 10);
+	EXPECT_EQ(pool.alloc_n(10).size(), 10);
+}
+
+TEST(Compact, DensePrefix)
+{
+	ObjectPool<Point> pp(100);
+	std::vector<PoolHandle> handles;
+	for (int i = 0; i < 100; ++i)
+	{
+		handles.push_back(pp.alloc_handle(i, -i));
+	}
+	for (int i = 0; i < 100; ++i)
+	{
+		if (i % 4 != 3)
+		{
+			pp.free(handles[i]);
+		}
+	}
+
+	std::vector<Relocation> table = pp.compact();
+	EXPECT_EQ(pp.num_free(), 75);
+
+	// the 25 live objects now sit in slots 0..24, the ones already there did not move
+	for (int i = 3; i < 100; i += 4)
+	{
+		PoolHandle handle = ObjectPool<Point>::relocate(handles[i], table);
+		ASSERT_NE(pp.get(handle), nullptr);
+		EXPECT_LT(handle.index(), 25);
+		if (i < 25)
+		{
+			EXPECT_EQ(handle, handles[i]);
+		}
+		EXPECT_EQ(pp.get(handle)->get_x(), i);
+		EXPECT_EQ(pp.get(handle)->get_y(), -i);
+	}
+
+	// stale handles stay stale, old handles to moved objects are stale too
+	EXPECT_EQ(ObjectPool<Point>::relocate(handles[0], table), PoolHandle{});
+	EXPECT_EQ(pp.get(handles[99]), nullptr);
+	EXPECT_NE(pp.get(handles[23]), nullptr);
+
+	std::vector<int> xs;
+	for (Point& point : pp)
+	{
+		xs.push_back(point.get_x());
+	}
+	std::sort(xs.begin(), xs.end());
+	EXPECT_EQ(xs.size(), 25);
+	EXPECT_EQ(xs.front(), 3);
+	EXPECT_EQ(xs.back(), 99);
+
+	EXPECT_EQ(pp.alloc_n(75).size(), 75);
+	EXPECT_THROW(pp.alloc(), std::out_of_range);
+}
+
+TEST(Compact, DecommitTail)
+{
+	static const size_t size = 100000;
+	ObjectPool<std::string> pool(size, { .growable = true });
+	std::vector<std::string*> strings = pool.alloc_n(size + 1000, "a string that is too long for the small buffer");
+	for (size_t i = 10; i < strings.size(); ++i)
+	{
+		pool.free(*strings[i]);
+	}
+
+	std::vector<Relocation> table = pool.compact(true);
+	EXPECT_EQ(table.size(), size + 1000);
+	EXPECT_EQ(pool.num_free(), pool.capacity() - 10);
+	for (std::string& s : pool)
+	{
+		EXPECT_EQ(s, "a string that is too long for the small buffer");
+	}
+
+	std::vector<std::string*> again = pool.alloc_n(size, "again");
+	EXPECT_EQ(*again.back(), "again");
+}
+
+TEST(Compact, BeyondHandles)
+{
+	// the last two slots have no handles
+	static const size_t size = PoolHandle::max_index + 2;
+	ObjectPool<uint64_t> pool(size, { .lazy_commit = true });
+	PoolHandle first = pool.alloc_handle(uint64_t(0));
+	PoolHandle second = pool.alloc_handle(uint64_t(1));
+	EXPECT_EQ(pool.alloc_n(PoolHandle::max_index - 2, uint64_t(2)).size(), PoolHandle::max_index - 2);
+	uint64_t& last = pool.alloc(uint64_t(3));
+	EXPECT_THROW(pool.alloc_handle(uint64_t(4)), std::length_error);
+	EXPECT_EQ(pool.num_free(), 1);
+	EXPECT_THROW(pool.handle_of(last), std::out_of_range);
+
+	pool.free(first);
+	std::vector<Relocation> table = pool.compact();
+	EXPECT_EQ(table.size(), PoolHandle::max_index);
+	for (const Relocation& r : table)
+	{
+		EXPECT_NE(r.after.index(), 0);
+	}
+
+	// the object from beyond the handles moved into the first slot and has a handle now
+	EXPECT_EQ(ObjectPool<uint64_t>::relocate(first, table), PoolHandle{});
+	EXPECT_EQ(ObjectPool<uint64_t>::relocate(second, table), second);
+	EXPECT_EQ(*pool.begin(), 3);
+	EXPECT_EQ(pool.handle_of(*pool.begin()).index(), 0);
+	EXPECT_EQ(pool.num_free(), 2);
+}
+
+constinit ObjectPool<P, 4> global_pool;	// constant-initialized, no constructor runs at startup
+
+TEST(Static, AllocAndFree)
+{
+	ObjectPool<Point, 3> pp;
+	EXPECT_EQ(pp.capacity(), 3);
+	EXPECT_GE(sizeof(pp), 3 * sizeof(Point));
+
+	Point& point1 = pp.alloc(1, 1);
+	Point& point2 = pp.alloc();
+	Point& point3 = pp.alloc(3, 3);
+	EXPECT_EQ(pp.try_alloc(), nullptr);
+	EXPECT_THROW(pp.alloc(), std::out_of_range);
+	EXPECT_EQ(pp.num_free(), 0);
+
+	pp.free(point2);
+	EXPECT_THROW(pp.free(point2), std::out_of_range);
+	Point outside;
+	EXPECT_THROW(pp.free(outside), std::out_of_range);
+
+	Point& point4 = pp.alloc(4, 4);
+	EXPECT_EQ(&point4, &point2);
+	EXPECT_EQ(point1.get_x() + point3.get_x() + point4.get_x(), 8);
+
+	int sum = 0;
+	pp.for_each_live([&](Point& point) { sum += point.get_y(); });
+	EXPECT_EQ(sum, 8);
+}
+
+TEST(Static, Global)
+{
+	P& p = global_pool.alloc(1, 2.0);
+	EXPECT_EQ(p.d, 2.0);
+	EXPECT_EQ(global_pool.num_free(), 3);
+	global_pool.free(p);
+	EXPECT_EQ(global_pool.num_free(), 4);
+}
+
+TEST(Static, OverAligned)
+{
+	ObjectPool<Aligned, 4> pool;
+	for (int i = 0; i < 4; ++i)
+	{
+		EXPECT_TRUE(is_aligned(&pool.alloc(), 64));
+	}
+}
+
+TEST(Static, DestroysLiveObjects)
+{
+	ObjectPool<std::string, 2> pool;
+	pool.alloc("a string that is too long for the small buffer");
+	pool.alloc("another string that is too long for the small buffer");
+}
+
+struct Counted
+{
+	static int alive;
+	Counted()
+	{
+		++alive;
+	}
+	Counted(const Counted&) noexcept
+	{
+		++alive;
+	}
+	~Counted()
+	{
+		--alive;
+	}
+};
+int Counted::alive = 0;
+
+TEST(Reset, DestroysLiveObjects)
+{
+	{
+		ObjectPool<Counted> pool(100);
+		std::vector<Counted*> objects = pool.alloc_n(80);
+		pool.free_n(std::span<Counted* const>(objects.data(), 30));
+		EXPECT_EQ(Counted::alive, 50);
+
+		pool.reset();
+		EXPECT_EQ(Counted::alive, 0);
+		EXPECT_EQ(pool.num_free(), 100);
+		EXPECT_TRUE(pool.begin() == pool.end());
+
+		pool.alloc_n(100);
+		EXPECT_EQ(Counted::alive, 100);
+	}
+	EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(Reset, TriviallyDestructible)
+{
+	ObjectPool<P> pool(10, { .growable = true });
+	for (int i = 0; i < 100; ++i)
+	{
+		pool.alloc(i, 0.0);
+	}
+	size_t capacity = pool.capacity();
+
+	pool.reset();
+	EXPECT_EQ(pool.num_free(), capacity);
+	EXPECT_EQ(pool.alloc_n(capacity).size(), capacity);
+	EXPECT_EQ(pool.capacity(), capacity);
+}
+
+TEST(Reset, HandlesGoStale)
+{
+	ObjectPool<Point> pp(4);
+	PoolHandle handle1 = pp.alloc_handle(1, 1);
+	PoolHandle handle2 = pp.alloc_handle(2, 2);
+	pp.reset();
+	EXPECT_EQ(pp.get(handle1), nullptr);
+
+	// the slots are reused, the old handles must not reach the new objects
+	PoolHandle handle3 = pp.alloc_handle(3, 3);
+	std::vector<Point*> more = pp.alloc_n(3);
+	EXPECT_EQ(handle3.index(), handle1.index());
+	EXPECT_EQ(pp.get(handle1), nullptr);
+	EXPECT_EQ(pp.get(handle2), nullptr);
+	EXPECT_EQ(pp.get(handle3)->get_x(), 3);
+}
+
+TEST(Reset, Static)
+{
+	{
+		ObjectPool<Counted, 8> pool;
+		for (int i = 0; i < 8; ++i)
+		{
+			pool.alloc();
+		}
+		pool.reset();
+		EXPECT_EQ(Counted::alive, 0);
+		EXPECT_EQ(pool.num_free(), 8);
+		pool.alloc();
+	}
+	EXPECT_EQ(Counted::alive, 0);
+}
+struct Triple
+{
+	uint64_t a, b, c;
+};
+
+// frees the objects picked by the predicate, gives the free pages back and fills the pool again
+template<typename Pick>
+void decommit_and_refill(ObjectPool<Triple>& pool, size_t count, Pick pick)
+{
+	std::vector<Triple*> objects = pool.alloc_n(count);
+	std::vector<Triple*> dead;
+	std::vector<Triple*> live;
+	for (size_t i = 0; i < count; ++i)
+	{
+		*objects[i] = { i, i, i };
+		(pick(i) ? dead : live).push_back(objects[i]);
+	}
+	pool.free_n(dead);
+	size_t num_free = pool.num_free();
+
+	EXPECT_GT(pool.decommit_free_pages(), 0);
+	EXPECT_EQ(pool.num_free(), num_free);
+	for (Triple* object : live)
+	{
+		EXPECT_EQ(object->a, object->c);
+	}
+
+	std::vector<Triple*> refilled = pool.alloc_n(num_free, Triple{ 0, 1, 2 });
+	EXPECT_EQ(pool.num_free(), 0);
+
+	refilled.insert(refilled.end(), live.begin(), live.end());
+	std::sort(refilled.begin(), refilled.end());
+	EXPECT_TRUE(std::adjacent_find(refilled.begin(), refilled.end()) == refilled.end());
+	for (Triple* object : live)
+	{
+		EXPECT_EQ(object->a, object->c);
+	}
+}
+
+TEST(LazyCommit, LargePool)
+{
+	ObjectPool<Triple> pool(1 << 20, { .lazy_commit = true });
+	EXPECT_EQ(pool.num_free(), 1 << 20);
+
+	std::vector<Triple*> objects = pool.alloc_n(1000, Triple{ 1, 2, 3 });
+	for (Triple* object : objects)
+	{
+		EXPECT_EQ(object->b, 2);
+	}
+	pool.free_n(objects);
+	EXPECT_EQ(pool.num_free(), 1 << 20);
+}
+
+TEST(LazyCommit, DecommitRuns)
+{
+	ObjectPool<Triple> pool(1 << 17, { .lazy_commit = true });
+	decommit_and_refill(pool, 1 << 16, [](size_t i) { return i >= 10000 && i < 50000; });
+}
+
+TEST(LazyCommit, DecommitScattered)
+{
+	// runs of 300 slots do not line up with pages, the slots at their ends keep their links
+	ObjectPool<Triple> pool(1 << 16);
+	decommit_and_refill(pool, 1 << 16, [](size_t i) { return (i / 300) % 2 == 1 || i % 1000 == 999; });
+}
+
+TEST(LazyCommit, Growable)
+{
+	ObjectPool<Triple> pool(1000, { .growable = true, .lazy_commit = true });
+	for (int i = 0; i < 3; ++i)
+	{
+		pool.alloc_n(pool.num_free() + 1);	// fills the pool and chains a chunk
+	}
+	decommit_and_refill(pool, pool.num_free(), [](size_t i) { return i % 2000 < 1500; });
+}
+
+struct Message
+{
+	std::vector<int> payload;
+	std::string text;
+};
+
+TEST(Recycle, KeepsCapacity)
+{
+	ObjectPool<Message> pool(4);
+	pool.set_recycle_hook([](Message& message) { message.payload.clear(); message.text.clear(); });
+
+	Message& message = pool.acquire();
+	message.payload.resize(1000);
+	message.text.assign(100, 'x');
+	const int* storage = message.payload.data();
+	pool.release(message);
+	EXPECT_EQ(pool.num_recycled(), 1);
+	EXPECT_EQ(pool.num_free(), 4);
+
+	Message& again = pool.acquire();
+	EXPECT_EQ(&again, &message);
+	EXPECT_TRUE(again.payload.empty());
+	EXPECT_TRUE(again.text.empty());
+	EXPECT_EQ(again.payload.data(), storage);
+	EXPECT_GE(again.payload.capacity(), 1000);
+	EXPECT_EQ(pool.num_recycled(), 0);
+	Message outside;
+	EXPECT_THROW(pool.release(outside), std::out_of_range);
+	pool.release(again);
+	EXPECT_THROW(pool.release(again), std::out_of_range);
+	EXPECT_THROW(pool.free(again), std::out_of_range);
+}
+
+TEST(Recycle, NoConstruction)
+{
+	{
+		ObjectPool<Counted> pool(10);
+		std::vector<Counted*> objects;
+		for (int i = 0; i < 5; ++i)
+		{
+			objects.push_back(&pool.acquire());
+		}
+		for (int round = 0; round < 10; ++round)
+		{
+			for (Counted* object : objects)
+			{
+				pool.release(*object);
+			}
+			for (Counted*& object : objects)
+			{
+				object = &pool.acquire();
+			}
+		}
+		EXPECT_EQ(Counted::alive, 5);
+
+		for (Counted* object : objects)
+		{
+			pool.release(*object);
+		}
+		EXPECT_EQ(Counted::alive, 5);
+		EXPECT_TRUE(pool.begin() == pool.end());
+	}
+	EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(Recycle, AllocTakesRecycledSlots)
+{
+	ObjectPool<Counted> pool(4);
+	for (int i = 0; i < 4; ++i)
+	{
+		pool.release(pool.alloc());
+	}
+	EXPECT_EQ(Counted::alive, 4);
+
+	// the pool is out of empty slots, alloc() destroys recycled objects to get some
+	pool.alloc_n(3);
+	EXPECT_EQ(Counted::alive, 4);
+	EXPECT_EQ(pool.num_recycled(), 1);
+	pool.alloc();
+	EXPECT_EQ(pool.num_recycled(), 0);
+	EXPECT_THROW(pool.acquire(), std::out_of_range);
+
+	pool.reset();
+	EXPECT_EQ(Counted::alive, 0);
+}
+
+TEST(Recycle, ClearAndCompact)
+{
+	ObjectPool<Counted> pool(8);
+	std::vector<Counted*> objects = pool.alloc_n(8);
+	for (int i = 0; i < 8; i += 2)
+	{
+		pool.release(*objects[i]);
+	}
+	pool.compact();
+	EXPECT_EQ(Counted::alive, 4);
+	EXPECT_EQ(pool.num_recycled(), 0);
+
+	pool.release(pool.alloc());
+	pool.clear_recycled();
+	EXPECT_EQ(Counted::alive, 4);
+	EXPECT_EQ(pool.num_free(), 4);
+	pool.reset();
+}
+
+template<size_t Buckets>
+uint64_t total(const std::array<uint64_t, Buckets>& histogram)
+{
+	uint64_t sum = 0;
+	for (uint64_t count : histogram)
+	{
+		sum += count;
+	}
+	return sum;
+}
+
+TEST(Stats, Disabled)
+{
+	EXPECT_TRUE(std::is_empty_v<NoStats>);
+	EXPECT_LT(sizeof(ObjectPool<Point>), sizeof(ObjectPool<Point, 0, PoolStats>));
+	EXPECT_LT(sizeof(ConcurrentObjectPool<Point>), sizeof(ConcurrentObjectPool<Point, PoolStats>));
+
+	ObjectPool<Point> pp(4);
+	pp.alloc();
+	EXPECT_EQ(pp.stats().allocations, 0);
+}
+
+TEST(Stats, Counters)
+{
+	ObjectPool<Point, 0, PoolStats> pp(4);
+	Point& point = pp.alloc();
+	pp.alloc_n(3);
+	pp.free(point);
+	EXPECT_EQ(pp.try_alloc(), &point);
+	EXPECT_EQ(pp.try_alloc(), nullptr);
+	EXPECT_THROW(pp.alloc_n(2), std::out_of_range);
+
+	PoolStatsSnapshot stats = pp.stats();
+	EXPECT_EQ(stats.allocations, 5);
+	EXPECT_EQ(stats.frees, 1);
+	EXPECT_EQ(stats.failed_allocations, 2);
+	EXPECT_EQ(stats.live, 4);
+	EXPECT_EQ(stats.high_water, 4);
+	EXPECT_EQ(total(stats.alloc_latency), 0);
+
+	pp.reset();
+	stats = pp.stats();
+	EXPECT_EQ(stats.frees, 5);
+	EXPECT_EQ(stats.live, 0);
+	EXPECT_EQ(stats.high_water, 4);
+}
+
+TEST(Stats, SampledLatency)
+{
+	ObjectPool<Point, 0, PoolStats> pp(100);
+	pp.set_stats_sample_rate(2);
+	std::vector<Point*> points;
+	for (int i = 0; i < 100; ++i)
+	{
+		points.push_back(&pp.alloc());
+	}
+	for (Point* point : points)
+	{
+		pp.free(*point);
+	}
+
+	// allocs and frees share the sample counter
+	PoolStatsSnapshot stats = pp.stats();
+	EXPECT_EQ(total(stats.alloc_latency) + total(stats.free_latency), 100);
+}
+
+TEST(Stats, ReadWhileAllocating)
+{
+	static const size_t num_threads = 4;
+	static const size_t iterations = 20000;
+	ConcurrentObjectPool<Point, PoolStats> pool(64);
+	pool.set_stats_sample_rate(16);
+
+	std::atomic<bool> done{};
+	std::thread reader([&]
+	{
+		while (!done)
+		{
+			PoolStatsSnapshot stats = pool.stats();
+			EXPECT_LE(stats.high_water, 64);
+		}
+	});
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&]
+		{
+			for (size_t i = 0; i < iterations; ++i)
+			{
+				if (Point* point = pool.try_alloc())
+				{
+					pool.free(*point);
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	done = true;
+	reader.join();
+
+	PoolStatsSnapshot stats = pool.stats();
+	EXPECT_EQ(stats.allocations + stats.failed_allocations, num_threads * iterations);
+	EXPECT_EQ(stats.allocations, stats.frees);
+	EXPECT_EQ(stats.live, 0);
+	EXPECT_GT(total(stats.alloc_latency), 0);
+}
+
+TEST(SoA, AllocGetFree)
+{
+	SoAPool<int, int> points(4);	// x and y of Point
+	PoolHandle a = points.alloc(1, 10);
+	PoolHandle b = points.alloc(2, 20);
+	PoolHandle c = points.alloc(3, 30);
+	EXPECT_EQ(*points.get<0>(b), 2);
+	EXPECT_EQ(points.at(c).get<1>(), 30);
+
+	// the last element moves into the hole, handles still find it
+	points.free(a);
+	EXPECT_EQ(points.get<0>(a), nullptr);
+	EXPECT_THROW(points.free(a), std::out_of_range);
+	EXPECT_THROW(points.at(a), std::out_of_range);
+	EXPECT_EQ(*points.get<0>(c), 3);
+	EXPECT_EQ(*points.get<1>(c), 30);
+	EXPECT_EQ(*points.get<1>(b), 20);
+	EXPECT_EQ(points.field<0>().size(), 2);
+	EXPECT_EQ(points.num_free(), 2);
+
+	// the freed slot is reused with a new generation
+	PoolHandle d = points.alloc(4, 40);
+	EXPECT_EQ(d.index(), a.index());
+	EXPECT_EQ(points.get<0>(a), nullptr);
+	points.alloc();
+	EXPECT_THROW(points.alloc(), std::out_of_range);
+	EXPECT_FALSE(points.is_live(PoolHandle{}));
+}
+
+TEST(SoA, DenseFields)
+{
+	static const size_t size = 1000;
+	SoAPool<float, float, uint8_t> particles(size);
+	std::vector<PoolHandle> handles;
+	for (size_t i = 0; i < size; ++i)
+	{
+		handles.push_back(particles.alloc(static_cast<float>(i), 1.0f, uint8_t(1)));
+	}
+	for (size_t i = 0; i < size; i += 3)
+	{
+		particles.free(handles[i]);
+	}
+
+	std::span<float> xs = particles.field<0>();
+	std::span<const float> vs = particles.field<1>();
+	EXPECT_EQ(xs.size(), size - (size + 2) / 3);
+	EXPECT_EQ(particles.size(), xs.size());
+	EXPECT_TRUE(is_aligned(xs.data(), cache_line_size));
+	EXPECT_TRUE(is_aligned(particles.field<2>().data(), cache_line_size));
+	for (size_t i = 0; i < xs.size(); ++i)
+	{
+		xs[i] += vs[i];
+	}
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (i % 3 != 0)
+		{
+			EXPECT_EQ(*particles.get<0>(handles[i]), static_cast<float>(i) + 1.0f);
+		}
+	}
+	for (size_t i = 0; i < particles.size(); ++i)
+	{
+		EXPECT_EQ(particles.get<0>(particles.handle_at(i)), &xs[i]);
+	}
+	EXPECT_THROW(particles.handle_at(particles.size()), std::out_of_range);
+}
+
+struct ThrowingField
+{
+	ThrowingField(int value)
+	{
+		if (value < 0)
+		{
+			throw std::invalid_argument("negative");
+		}
+	}
+};
+
+TEST(SoA, NonTrivialFields)
+{
+	SoAPool<std::string, std::vector<int>, ThrowingField> pool(8);
+	PoolHandle a = pool.alloc(std::string(100, 'a'), std::vector<int>(100, 1), 1);
+	PoolHandle b = pool.alloc(std::string(100, 'b'), std::vector<int>(100, 2), 1);
+	EXPECT_THROW(pool.alloc(std::string(100, 'c'), std::vector<int>(100, 3), -1), std::invalid_argument);
+	EXPECT_EQ(pool.num_free(), 6);
+
+	pool.free(a);
+	EXPECT_EQ(pool.get<0>(b)->front(), 'b');
+	EXPECT_EQ(pool.at(b).get<1>()[99], 2);
+	pool.alloc(std::string(100, 'd'), std::vector<int>(100, 4), 1);
+}
+
+struct Node
+{
+	uint64_t value;
+	uint64_t check;
+
+	Node(uint64_t _value) : value(_value), check(~_value) {}
+
+	~Node()
+	{
+		value = 0;
+		check = 0;
+	}
+};
+
+TEST(Epoch, DefersWhilePinned)
+{
+	EpochObjectPool<Node> pool(8);
+	Node& node = pool.alloc(uint64_t(1));
+	{
+		auto guard = pool.pin();
+		{
+			auto nested = pool.pin();
+		}
+		pool.retire(node);
+		for (int i = 0; i < 5; ++i)
+		{
+			EXPECT_EQ(pool.collect(), 0);
+		}
+		EXPECT_EQ(node.check, ~uint64_t(1));
+		EXPECT_EQ(pool.num_free(), 7);
+	}
+
+	size_t freed = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		freed += pool.collect();
+	}
+	EXPECT_EQ(freed, 1);
+	EXPECT_EQ(pool.num_retired(), 0);
+	EXPECT_EQ(pool.num_free(), 8);
+
+	Node outside(2);
+	EXPECT_THROW(pool.retire(outside), std::out_of_range);
+}
+
+TEST(Epoch, RetireTwice)
+{
+	EpochObjectPool<Node> pool(8, 64, 2);
+	Node& node = pool.alloc(uint64_t(1));
+	pool.retire(node);
+	EXPECT_THROW(pool.retire(node), std::out_of_range);
+	EXPECT_THROW(pool.free(node), std::out_of_range);
+	EXPECT_EQ(pool.num_retired(), 1);
+
+	// reclaimed once, the slot can be allocated and retired again
+	while (pool.num_retired() != 0)
+	{
+		pool.collect();
+	}
+	EXPECT_EQ(pool.num_free(), 8);
+	Node& again = pool.alloc(uint64_t(2));
+	EXPECT_EQ(&again, &node);
+	pool.retire(again);
+	EXPECT_EQ(pool.num_retired(), 1);
+}
+
+TEST(Epoch, WaitsForOtherThread)
+{
+	EpochObjectPool<Node> pool(8);
+	Node& node = pool.alloc(uint64_t(1));
+
+	std::atomic<int> step{};
+	std::thread reader([&]
+	{
+		auto guard = pool.pin();
+		step = 1;
+		while (step != 2)
+		{
+			std::this_thread::yield();
+		}
+	});
+	while (step != 1)
+	{
+		std::this_thread::yield();
+	}
+
+	pool.retire(node);
+	pool.collect();
+	pool.collect();
+	EXPECT_EQ(pool.num_retired(), 1);
+
+	step = 2;
+	reader.join();
+	pool.collect();
+	pool.collect();
+	EXPECT_EQ(pool.num_retired(), 0);
+}
+
+TEST(Epoch, TooManyReaders)
+{
+	EpochObjectPool<Node> pool(8, 1);
+	auto guard = pool.pin();
+	std::thread other([&] { EXPECT_THROW(pool.pin(), std::length_error); });
+	other.join();
+}
+
+TEST(Epoch, Stress)
+{
+	static const size_t num_readers = 3;
+	static const uint64_t updates = 20000;
+	EpochObjectPool<Node> pool(1024, 8, 16);
+	std::atomic<Node*> current = &pool.alloc(uint64_t(1));
+
+	std::atomic<bool> done{};
+	std::atomic<size_t> errors{};
+	std::vector<std::thread> readers;
+	for (size_t t = 0; t < num_readers; ++t)
+	{
+		readers.emplace_back([&]
+		{
+			while (!done)
+			{
+				auto guard = pool.pin();
+				Node* node = current.load(std::memory_order_acquire);
+				if (node->check != ~node->value)
+				{
+					++errors;
+				}
+			}
+		});
+	}
+
+	for (uint64_t i = 2; i <= updates; ++i)
+	{
+		Node* fresh = pool.try_alloc(i);
+		while (fresh == nullptr)
+		{
+			pool.collect();
+			std::this_thread::yield();
+			fresh = pool.try_alloc(i);
+		}
+		pool.retire(*current.exchange(fresh, std::memory_order_acq_rel));
+	}
+	done = true;
+	for (std::thread& reader : readers)
+	{
+		reader.join();
+	}
+
+	EXPECT_EQ(errors, 0);
+	for (int i = 0; i < 3; ++i)
+	{
+		pool.collect();
+	}
+	EXPECT_EQ(pool.num_retired(), 0);
+	EXPECT_EQ(pool.num_free(), 1023);
+}
+
+TEST(Numa, Topology)
+{
+	EXPECT_GE(numa_node_count(), 1);
+	EXPECT_LT(current_numa_node(), numa_node_count());
+
+	NumaObjectPool<Point> pool;
+	EXPECT_EQ(pool.num_nodes(), numa_node_count());
+	Point& point = pool.alloc(1, 2);
+	EXPECT_EQ(point.get_y(), 2);
+	pool.free(point);
+}
+
+TEST(Numa, NodesAndFallback)
+{
+	// more nodes than the machine has, mbind fails for them and the pool works on
+	NumaObjectPool<Point> pool(100, {}, 2);
+	size_t local = current_numa_node() % 2;
+
+	std::vector<Point*> points;
+	for (int i = 0; i < 100; ++i)
+	{
+		points.push_back(pool.try_alloc_on(local, i, i));
+	}
+	EXPECT_EQ(pool.num_free(local), 0);
+	for (Point* point : points)
+	{
+		EXPECT_EQ(pool.node_of(*point), local);
+	}
+
+	// the local node is full, the other one takes over
+	Point& spilled = *pool.try_alloc_on(local);
+	EXPECT_EQ(pool.node_of(spilled), 1 - local);
+	EXPECT_EQ(pool.num_free(), 99);
+	if (numa_node_count() == 1)
+	{
+		EXPECT_FALSE(pool.is_bound(1));
+	}
+
+	// freeing on another thread goes back to the owning node
+	std::thread other([&]
+	{
+		for (Point* point : points)
+		{
+			pool.free(*point);
+		}
+	});
+	other.join();
+	EXPECT_EQ(pool.num_free(local), 100);
+
+	Point outside;
+	EXPECT_THROW(pool.free(outside), std::out_of_range);
+	pool.free(spilled);
+	EXPECT_THROW(pool.free(spilled), std::out_of_range);
+	EXPECT_EQ(pool.num_free(), 200);
+}
+
+TEST(Numa, BoundBuffer)
+{
+	static const size_t bytes = 1 << 16;
+	AlignedBuffer buffer = make_mapped_buffer(bytes, cache_line_size, 0);
+	std::memset(buffer.get(), 1, bytes);
+	EXPECT_EQ(buffer[bytes - 1], 1);
+	EXPECT_FALSE(make_mapped_buffer(bytes, cache_line_size).get_deleter().numa_bound());
+	EXPECT_FALSE(make_aligned_buffer(bytes, cache_line_size).get_deleter().numa_bound());
+
+	// node 0 exists everywhere, it is bound wherever the kernel supports mbind
+	ObjectPool<P> pool(1000, { .numa_node = 0 });
+	EXPECT_EQ(pool.alloc(1, 2.0).i, 1);
+	EXPECT_EQ(pool.numa_bound(), buffer.get_deleter().numa_bound());
+	EXPECT_FALSE(ObjectPool<P>(1000).numa_bound());
+}
+
+// lazily started coroutine returning an int, its frame comes from the FramePool
+class PooledTask
+{
+public:
+	struct promise_type : PooledFrame
+	{
+		int value{};
+
+		PooledTask get_return_object()
+		{
+			return PooledTask(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_value(int _value) { value = _value; }
+		void unhandled_exception() { throw; }
+	};
+
+	PooledTask(PooledTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+	~PooledTask()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	int run()
+	{
+		handle.resume();
+		return handle.promise().value;
+	}
+
+	void* frame() const
+	{
+		return handle.address();
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit PooledTask(std::coroutine_handle<promise_type> _handle) : handle(_handle) {}
+};
+
+PooledTask add(int a, int b)
+{
+	co_return a + b;
+}
+
+TEST(Coroutine, ReusesFrames)
+{
+	void* frame{};
+	{
+		PooledTask task = add(1, 2);
+		EXPECT_EQ(task.run(), 3);
+		EXPECT_EQ(FramePool::live_frames(), 1);
+		frame = task.frame();
+	}
+	EXPECT_EQ(FramePool::live_frames(), 0);
+
+	for (int i = 0; i < 100; ++i)
+	{
+		PooledTask task = add(i, i);
+		EXPECT_EQ(task.frame(), frame);
+		EXPECT_EQ(task.run(), 2 * i);
+	}
+}
+
+TEST(Coroutine, DestroyedOnOtherThread)
+{
+	std::vector<PooledTask> tasks;
+	std::thread creator([&]
+	{
+		for (int i = 0; i < 10; ++i)
+		{
+			tasks.push_back(add(i, 1));
+		}
+	});
+	creator.join();
+
+	// the creating thread is gone, its slabs stay until the last frame is freed
+	for (size_t i = 0; i < tasks.size(); ++i)
+	{
+		EXPECT_EQ(tasks[i].run(), static_cast<int>(i) + 1);
+	}
+	tasks.clear();
+
+	// frames of a live thread freed here go back to it
+	std::atomic<int> step{};
+	void* frame{};
+	std::thread owner([&]
+	{
+		tasks.push_back(add(2, 2));
+		frame = tasks[0].frame();
+		step = 1;
+		while (step != 2)
+		{
+			std::this_thread::yield();
+		}
+		EXPECT_EQ(FramePool::live_frames(), 1);
+		PooledTask again = add(3, 3);	// takes the returned frame back
+		EXPECT_EQ(again.frame(), frame);
+		EXPECT_EQ(FramePool::live_frames(), 1);
+	});
+	while (step != 1)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(tasks[0].run(), 4);
+	tasks.clear();
+	step = 2;
+	owner.join();
+}
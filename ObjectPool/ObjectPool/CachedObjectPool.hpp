@@ -0,0 +1,184 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include <stdexcept>
+#include "ObjectPool.hpp"
+
+/* Thread-local caching front end.
+   Every thread keeps a small stack of unused slots and only locks the shared pool
+   to take or give back a whole batch of them. A slot freed on another thread goes
+   to that thread's stack and comes back to the shared pool with its next batch.
+   Objects still live when the pool is destroyed are destroyed with it, the caches
+   of other threads do not keep the pool alive and drop their slots. */
+
+template<typename T>
+class CachedObjectPool
+{
+private:
+	struct Storage
+	{
+		alignas(T) unsigned char bytes[sizeof(T)];
+		std::atomic<bool> live{};	// set while the slot holds an object, shares the object's cache line
+
+		Storage() {}	// leaves the bytes uninitialized
+	};
+
+	struct Shared
+	{
+		ObjectPool<Storage> pool;
+		std::mutex mutex;
+
+		Shared(size_t size) : pool(size) {}
+	};
+
+	struct Cache
+	{
+		std::weak_ptr<Shared> shared;	// expires with the pool
+		const Shared* key{};
+		std::vector<Storage*> slots;
+		size_t batch{};
+
+		~Cache()
+		{
+			// the slots of a destroyed pool went with it
+			if (std::shared_ptr<Shared> pool = shared.lock())
+			{
+				give_back(*pool, slots.size());
+			}
+		}
+
+		void give_back(Shared& pool, size_t count)
+		{
+			std::lock_guard<std::mutex> guard(pool.mutex);
+			for (size_t i = 0; i < count; ++i)
+			{
+				pool.pool.free(*slots.back());
+				slots.pop_back();
+			}
+		}
+
+		bool refill(Shared& pool)
+		{
+			std::lock_guard<std::mutex> guard(pool.mutex);
+			for (size_t i = 0; i < batch; ++i)
+			{
+				Storage* slot = pool.pool.try_alloc();
+				if (slot == nullptr)
+				{
+					break;
+				}
+				slots.push_back(slot);
+			}
+			return !slots.empty();
+		}
+	};
+
+	// caches of the current thread, one per pool it has used
+	static std::vector<std::shared_ptr<Cache>>& thread_caches()
+	{
+		static thread_local std::vector<std::shared_ptr<Cache>> caches;
+		return caches;
+	}
+
+	std::shared_ptr<Shared> shared;
+	size_t batch{};
+
+	Cache& local_cache()
+	{
+		std::vector<std::shared_ptr<Cache>>& caches = thread_caches();
+		for (size_t i = caches.size(); i-- > 0;)
+		{
+			// a destroyed pool may have left a cache at the same address
+			if (caches[i]->key == shared.get() && !caches[i]->shared.expired())
+			{
+				return *caches[i];
+			}
+		}
+
+		// drop the caches of destroyed pools before adding a new one
+		std::erase_if(caches, [](const std::shared_ptr<Cache>& cache) { return cache->shared.expired(); });
+
+		auto cache = std::make_shared<Cache>();
+		cache->shared = shared;
+		cache->key = shared.get();
+		cache->batch = batch;
+		cache->slots.reserve(2 * batch);
+		caches.push_back(cache);
+		return *cache;
+	}
+
+public:
+	CachedObjectPool(size_t size = default_size, size_t _batch = 32)
+		: shared(std::make_shared<Shared>(size)), batch(_batch > 0 ? _batch : 1) {}
+
+	CachedObjectPool(const CachedObjectPool&) = delete;
+	CachedObjectPool& operator=(const CachedObjectPool&) = delete;
+
+	template<typename... Args>
+	T& alloc(Args&&... args)
+	{
+		T* ptr = try_alloc(std::forward<Args>(args)...);
+		if (ptr == nullptr)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		return *ptr;
+	}
+
+	// returns nullptr when neither this thread's cache nor the shared pool has a free slot
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		Cache& cache = local_cache();
+		if (cache.slots.empty() && !cache.refill(*shared))
+		{
+			return nullptr;
+		}
+
+		Storage* slot = cache.slots.back();
+		T* ptr = new(slot->bytes) T{ std::forward<Args>(args)... };
+		cache.slots.pop_back();
+		slot->live.store(true, std::memory_order_relaxed);
+		return ptr;
+	}
+
+	void free(T& object)
+	{
+		Storage* slot = reinterpret_cast<Storage*>(&object);
+		// clearing the flag claims the object, so a double free or a slot still in a cache throws
+		if (!shared->pool.owns(*slot) || !slot->live.exchange(false, std::memory_order_relaxed))
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+
+		object.~T();
+		Cache& cache = local_cache();
+		cache.slots.push_back(slot);
+		if (cache.slots.size() >= 2 * batch)
+		{
+			cache.give_back(*shared, batch);
+		}
+	}
+
+	~CachedObjectPool()
+	{
+		std::erase_if(thread_caches(), [this](const std::shared_ptr<Cache>& cache) { return cache->key == shared.get(); });
+
+		// the shared pool also counts the slots in caches, only the flagged ones hold an object
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			std::lock_guard<std::mutex> guard(shared->mutex);
+			shared->pool.for_each_live([](Storage& slot)
+			{
+				if (slot.live.load(std::memory_order_relaxed))
+				{
+					reinterpret_cast<T*>(slot.bytes)->~T();
+				}
+			});
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <bit>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include "ObjectPool.hpp"
+
+/* Thread-safe pool with lock-free alloc and free.
+   Unused slots form a stack of indices, the head is tagged with a counter to avoid ABA. */
+
+template<typename T, typename Stats = NoStats>
+class ConcurrentObjectPool
+{
+private:
+	static const uint32_t npos = static_cast<uint32_t>(-1);
+	static const size_t word_bits = 64;
+
+	SlotLayout layout;
+	AlignedBuffer pool;									// pool
+	std::unique_ptr<std::atomic<uint32_t>[]> next;		// next unused slot for every unused slot
+	std::unique_ptr<std::atomic<uint64_t>[]> usage;		// occupancy bitmap assossiated with pool
+	size_t size{};										// size of pool
+	char* data{};										// ptr to the head of pool
+
+	std::atomic<uint64_t> head{};						// tag in the high half, index in the low half
+	std::atomic<size_t> used{};							// number of live objects
+	OBJECTPOOL_NO_UNIQUE_ADDRESS Stats pool_stats;
+
+	static uint64_t pack(uint64_t tag, uint32_t i)
+	{
+		return (tag << 32) | i;
+	}
+
+	uint32_t pop_free()
+	{
+		uint64_t old_head = head.load(std::memory_order_acquire);
+		for (;;)
+		{
+			uint32_t i = static_cast<uint32_t>(old_head);
+			if (i == npos)
+			{
+				return npos;
+			}
+			// next[i] may be stale if another thread took i meanwhile, the tag makes the CAS fail then
+			uint64_t new_head = pack((old_head >> 32) + 1, next[i].load(std::memory_order_relaxed));
+			if (head.compare_exchange_weak(old_head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return i;
+			}
+		}
+	}
+
+	void push_free(uint32_t i)
+	{
+		uint64_t old_head = head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			next[i].store(static_cast<uint32_t>(old_head), std::memory_order_relaxed);
+			uint64_t new_head = pack((old_head >> 32) + 1, i);
+			if (head.compare_exchange_weak(old_head, new_head, std::memory_order_release, std::memory_order_relaxed))
+			{
+				return;
+			}
+		}
+	}
+
+	T* slot(size_t i)
+	{
+		return reinterpret_cast<T*>(data + i * layout.stride);
+	}
+
+	// index of the slot the object lives in, anything not below size if it is not from this pool
+	size_t index_of(const T& object) const
+	{
+		const char* object_ptr = reinterpret_cast<const char*>(&object);
+		if (std::less_equal<const char*>()(data, object_ptr) && (object_ptr - data) % layout.stride == 0)
+		{
+			return (object_ptr - data) / layout.stride;
+		}
+		return static_cast<size_t>(-1);
+	}
+
+public:
+	// options.growable is not supported
+	ConcurrentObjectPool(size_t _size = default_size, PoolOptions options = {})
+		: layout(sizeof(T), alignof(T), options), size(_size)
+	{
+		if (size >= npos)
+		{
+			throw std::length_error("ConcurrentObjectPool is too big!\n");
+		}
+
+		pool = options.lazy_commit || options.numa_node >= 0 ? make_mapped_buffer(layout.stride * size, layout.alignment, options.numa_node)
+			: make_aligned_buffer(layout.stride * size, layout.alignment);
+		data = pool.get();
+
+		next = std::make_unique<std::atomic<uint32_t>[]>(size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			next[i].store(i + 1 < size ? static_cast<uint32_t>(i + 1) : npos, std::memory_order_relaxed);
+		}
+		head.store(pack(0, size > 0 ? 0 : npos), std::memory_order_relaxed);
+
+		usage = std::make_unique<std::atomic<uint64_t>[]>((size + word_bits - 1) / word_bits);
+	}
+
+	ConcurrentObjectPool(const ConcurrentObjectPool&) = delete;
+	ConcurrentObjectPool& operator=(const ConcurrentObjectPool&) = delete;
+
+	template<typename... Args>
+	T& alloc(Args&&... args)
+	{
+		T* ptr = try_alloc(std::forward<Args>(args)...);
+		if (ptr == nullptr)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		return *ptr;
+	}
+
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		typename Stats::Sample sample = pool_stats.sample();
+		uint32_t i = pop_free();
+		if (i == npos)
+		{
+			pool_stats.on_failed_alloc();
+			return nullptr;
+		}
+
+		T* ptr{};
+		try
+		{
+			ptr = new(slot(i)) T{ std::forward<Args>(args)... };
+		}
+		catch (...)
+		{
+			push_free(i);
+			throw;
+		}
+		usage[i / word_bits].fetch_or(uint64_t(1) << (i % word_bits), std::memory_order_relaxed);
+		used.fetch_add(1, std::memory_order_relaxed);
+		pool_stats.on_alloc(1, sample);
+		return ptr;
+	}
+
+	void free(T& object)
+	{
+		typename Stats::Sample sample = pool_stats.sample();
+		size_t i = index_of(object);
+		uint64_t bit = uint64_t(1) << (i % word_bits);
+		// clearing the bit claims the object, so a concurrent double free throws in one of the threads
+		if (i >= size || (usage[i / word_bits].fetch_and(~bit, std::memory_order_relaxed) & bit) == 0)
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+
+		object.~T();
+		used.fetch_sub(1, std::memory_order_relaxed);
+		push_free(static_cast<uint32_t>(i));
+		pool_stats.on_free(1, sample);
+	}
+
+	size_t num_free() const
+	{
+		return size - used.load(std::memory_order_relaxed);
+	}
+
+	// true if the object lies in one of the slots of this pool, whether it is live or not
+	bool owns(const T& object) const
+	{
+		return index_of(object) < size;
+	}
+
+	// index of the slot the object lies in, not below capacity() if it is not from this pool
+	size_t slot_index(const T& object) const
+	{
+		return index_of(object);
+	}
+
+	size_t capacity() const
+	{
+		return size;
+	}
+
+	// true if options.numa_node was given and the kernel bound the slots to that node
+	bool numa_bound() const
+	{
+		return pool.get_deleter().numa_bound();
+	}
+
+	// true if the object is from this pool and has not been freed
+	bool is_live(const T& object) const
+	{
+		size_t i = index_of(object);
+		return i < size && (usage[i / word_bits].load(std::memory_order_relaxed) >> (i % word_bits)) & 1;
+	}
+
+	// all zero unless Stats is PoolStats, safe to call while other threads allocate
+	PoolStatsSnapshot stats() const
+	{
+		return pool_stats.snapshot();
+	}
+
+	void set_stats_sample_rate(size_t rate)
+	{
+		pool_stats.set_sample_rate(rate);
+	}
+
+	~ConcurrentObjectPool()
+	{
+		for (size_t w = 0; w < (size + word_bits - 1) / word_bits; ++w)
+		{
+			for (uint64_t bits = usage[w].load(std::memory_order_relaxed); bits != 0; bits &= bits - 1)
+			{
+				slot(w * word_bits + std::countr_zero(bits))->~T();
+			}
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+#include "ObjectPool.hpp"
+#include "ConcurrentObjectPool.hpp"
+
+/* Concurrent pool with epoch-based reclamation.
+   Readers pin the current epoch for as long as they hold pointers to pool objects,
+   pinning is an atomic store and a fence and takes no lock. A writer retires an object
+   instead of freeing it, once every reader that was pinned at the time of the
+   retire has unpinned, the object is destroyed and its slot reused. Retired
+   objects are reclaimed in batches by collect(), which retire() calls every
+   batch retires.
+
+   {
+       auto guard = pool.pin();
+       read(shared_ptr.load());	// the object can not be destroyed before guard is
+   }
+   T* old = shared_ptr.exchange(&pool.alloc());
+   pool.retire(*old); */
+
+template<typename T>
+class EpochObjectPool
+{
+private:
+	static const uint64_t idle = static_cast<uint64_t>(-1);
+	static const size_t word_bits = 64;
+
+	// epoch announced by one reader thread, idle while it is not pinned
+	struct alignas(cache_line_size) Record
+	{
+		std::atomic<uint64_t> epoch{ idle };
+		std::atomic<bool> owned{};
+		size_t depth{};		// nested pins, only touched by the owner
+	};
+
+	// outlives the pool while threads still refer to their records
+	struct Registry
+	{
+		std::unique_ptr<Record[]> records;
+		size_t size{};
+		std::atomic<uint64_t> epoch{};
+
+		Registry(size_t _size) : records(std::make_unique<Record[]>(_size)), size(_size) {}
+	};
+
+	// the record of the current thread in one pool
+	struct Entry
+	{
+		std::weak_ptr<Registry> registry;
+		const Registry* key{};
+		size_t record{};
+	};
+
+	// records of the current thread, given back when the thread exits
+	struct ThreadEntries
+	{
+		std::vector<Entry> entries;
+
+		~ThreadEntries()
+		{
+			for (Entry& entry : entries)
+			{
+				if (std::shared_ptr<Registry> registry = entry.registry.lock())
+				{
+					release(*registry, entry.record);
+				}
+			}
+		}
+	};
+
+	struct Retired
+	{
+		T* object;
+		uint64_t epoch;
+	};
+
+	ConcurrentObjectPool<T> pool;
+	std::unique_ptr<std::atomic<uint64_t>[]> retiring;	// one bit per slot, set from retire() until the object is reclaimed
+	std::shared_ptr<Registry> registry;
+	std::mutex mutex_retired;
+	std::vector<Retired> retired;
+	size_t batch{};
+
+	// sets or clears the retiring bit of the object's slot, returns whether it was set before
+	bool mark_retiring(const T& object, bool set)
+	{
+		size_t i = pool.slot_index(object);
+		uint64_t bit = uint64_t(1) << (i % word_bits);
+		uint64_t old = set ? retiring[i / word_bits].fetch_or(bit, std::memory_order_relaxed)
+			: retiring[i / word_bits].fetch_and(~bit, std::memory_order_relaxed);
+		return (old & bit) != 0;
+	}
+
+	static std::vector<Entry>& thread_entries()
+	{
+		static thread_local ThreadEntries entries;
+		return entries.entries;
+	}
+
+	static void release(Registry& registry, size_t record)
+	{
+		registry.records[record].depth = 0;
+		registry.records[record].epoch.store(idle, std::memory_order_release);
+		registry.records[record].owned.store(false, std::memory_order_release);
+	}
+
+	Entry& local_entry()
+	{
+		std::vector<Entry>& entries = thread_entries();
+		for (Entry& entry : entries)
+		{
+			if (entry.key == registry.get() && !entry.registry.expired())
+			{
+				return entry;
+			}
+		}
+
+		// drop the entries of destroyed pools before claiming a record
+		std::erase_if(entries, [](const Entry& entry) { return entry.registry.expired(); });
+
+		for (size_t i = 0; i < registry->size; ++i)
+		{
+			bool owned = false;
+			if (registry->records[i].owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+			{
+				entries.push_back({ registry, registry.get(), i });
+				return entries.back();
+			}
+		}
+		throw std::length_error("Too many reader threads!\n");
+	}
+
+	// the epoch can move on once every pinned reader has seen the current one
+	bool try_advance()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		uint64_t epoch = registry->epoch.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < registry->size; ++i)
+		{
+			uint64_t local = registry->records[i].epoch.load(std::memory_order_acquire);
+			if (local != idle && local != epoch)
+			{
+				return false;
+			}
+		}
+		return registry->epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+	}
+
+public:
+	class ReadGuard
+	{
+	public:
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+
+		~ReadGuard()
+		{
+			if (--record.depth == 0)
+			{
+				record.epoch.store(idle, std::memory_order_release);
+			}
+		}
+
+	private:
+		friend class EpochObjectPool;
+
+		Record& record;
+
+		ReadGuard(Record& _record) : record(_record) {}
+	};
+
+	// max_readers is the number of threads that may pin at the same time
+	EpochObjectPool(size_t size = default_size, size_t max_readers = 64, size_t _batch = 64, PoolOptions options = {})
+		: pool(size, options), retiring(std::make_unique<std::atomic<uint64_t>[]>((pool.capacity() + word_bits - 1) / word_bits)),
+		registry(std::make_shared<Registry>(max_readers)), batch(_batch > 0 ? _batch : 1) {}
+
+	EpochObjectPool(const EpochObjectPool&) = delete;
+	EpochObjectPool& operator=(const EpochObjectPool&) = delete;
+
+	template<typename... Args>
+	T& alloc(Args&&... args)
+	{
+		return pool.alloc(std::forward<Args>(args)...);
+	}
+
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		return pool.try_alloc(std::forward<Args>(args)...);
+	}
+
+	// objects the pool hands out stay valid until the guard is destroyed, guards may nest
+	ReadGuard pin()
+	{
+		Record& record = registry->records[local_entry().record];
+		if (record.depth++ == 0)
+		{
+			// the announcement must be visible before the reads it protects, and must not be
+			// of an epoch that was left meanwhile, writers would not wait for it then
+			uint64_t epoch = registry->epoch.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				record.epoch.store(epoch, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				uint64_t current = registry->epoch.load(std::memory_order_relaxed);
+				if (current == epoch)
+				{
+					break;
+				}
+				epoch = current;
+			}
+		}
+		return ReadGuard(record);
+	}
+
+	// frees at once, only for objects no reader can reach anymore and that have not been retired
+	void free(T& object)
+	{
+		if (pool.owns(object))
+		{
+			size_t i = pool.slot_index(object);
+			if ((retiring[i / word_bits].load(std::memory_order_relaxed) >> (i % word_bits)) & 1)
+			{
+				throw std::out_of_range("Could not free object!\n");
+			}
+		}
+		pool.free(object);
+	}
+
+	// the object must be unreachable for new readers already, it is freed when the current ones are done
+	void retire(T& object)
+	{
+		// setting the bit claims the object, so retiring it twice throws instead of freeing it twice
+		if (!pool.is_live(object) || mark_retiring(object, true))
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+
+		// orders the unlinking of the object before the epoch is read, see pin()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		uint64_t epoch = registry->epoch.load(std::memory_order_relaxed);
+
+		size_t pending{};
+		{
+			std::lock_guard<std::mutex> guard(mutex_retired);
+			retired.push_back({ &object, epoch });
+			pending = retired.size();
+		}
+		if (pending % batch == 0)
+		{
+			collect();
+		}
+	}
+
+	// frees the retired objects no reader can hold anymore, returns how many
+	size_t collect()
+	{
+		try_advance();
+		uint64_t epoch = registry->epoch.load(std::memory_order_acquire);
+
+		// an object retired in epoch e may be held by readers pinned at e - 1 or e
+		std::vector<T*> reclaimable;
+		{
+			std::lock_guard<std::mutex> guard(mutex_retired);
+			std::erase_if(retired, [&](const Retired& r)
+			{
+				if (r.epoch + 2 <= epoch)
+				{
+					reclaimable.push_back(r.object);
+					return true;
+				}
+				return false;
+			});
+		}
+		for (T* object : reclaimable)
+		{
+			// cleared first, the slot may be allocated and retired again as soon as it is free
+			mark_retiring(*object, false);
+			pool.free(*object);
+		}
+		return reclaimable.size();
+	}
+
+	size_t num_retired()
+	{
+		std::lock_guard<std::mutex> guard(mutex_retired);
+		return retired.size();
+	}
+
+	size_t num_free() const
+	{
+		return pool.num_free();
+	}
+
+	// no reader may be pinned anymore, retired objects are destroyed by the pool
+	~EpochObjectPool()
+	{
+		std::erase_if(thread_entries(), [this](const Entry& entry) { return entry.key == registry.get(); });
+	}
+};
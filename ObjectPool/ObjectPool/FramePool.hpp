@@ -0,0 +1,209 @@
+#pragma once
+
+#include <bit>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include "PoolResource.hpp"
+
+/* Pool for coroutine frames.
+   Every thread keeps a free list per frame size class, backed by its own
+   size-class slabs (a PoolResource), so creating a coroutine pops a frame from
+   a thread-local list instead of calling global new. A frame destroyed on
+   another thread goes back to the thread that created it, which takes it over
+   on its next allocation. A thread's frames live on after the thread until the
+   last one is freed.
+
+   struct promise_type : PooledFrame { ... }; */
+
+class FramePool
+{
+private:
+	static constexpr size_t alignment = alignof(std::max_align_t);
+	static constexpr size_t min_class = 64;
+	static constexpr size_t num_classes = 7;	// 64 to 4096 bytes, bigger frames go upstream
+
+	using Resource = BasicPoolResource<64, 128, 256, 512, 1024, 2048, 4096>;
+
+	// an unused frame keeps the next unused frame of its class
+	struct FreeFrame
+	{
+		FreeFrame* next;
+	};
+
+	struct Cache
+	{
+		Resource resource;
+		std::array<FreeFrame*, num_classes> free{};
+		size_t live{};						// frames not freed yet, changed with mutex_remote locked once the thread has exited
+		std::mutex mutex_remote;
+		std::vector<std::pair<void*, size_t>> remote;	// frames freed by other threads
+		std::atomic<bool> has_remote{};
+		bool alive{ true };					// false once the thread has exited
+	};
+
+	// in front of every frame, padded to keep the frame aligned
+	struct alignas(alignment) Header
+	{
+		Cache* owner;
+	};
+
+	struct ThreadCache
+	{
+		Cache* cache{};
+
+		~ThreadCache()
+		{
+			// frames freed on this thread from now on take the path of other threads
+			Cache* own = std::exchange(cache, nullptr);
+			if (own == nullptr)
+			{
+				return;
+			}
+			bool last{};
+			{
+				std::lock_guard<std::mutex> guard(own->mutex_remote);
+				own->alive = false;
+				drain(*own);
+				last = own->live == 0;
+			}
+			if (last)
+			{
+				delete own;
+			}
+		}
+	};
+
+	static ThreadCache& thread_cache()
+	{
+		static thread_local ThreadCache cache;
+		return cache;
+	}
+
+	// index of the smallest class that holds the bytes, num_classes if none does
+	static size_t class_of(size_t bytes)
+	{
+		size_t c = bytes <= min_class ? 0 : std::bit_width((bytes - 1) / min_class);
+		return std::min(c, num_classes);
+	}
+
+	static void give_back(Cache& cache, void* ptr, size_t bytes)
+	{
+		size_t c = class_of(bytes);
+		if (c == num_classes)
+		{
+			cache.resource.deallocate(ptr, bytes, alignment);
+			return;
+		}
+		FreeFrame* frame = static_cast<FreeFrame*>(ptr);
+		frame->next = cache.free[c];
+		cache.free[c] = frame;
+	}
+
+	// called with mutex_remote locked
+	static void drain(Cache& cache)
+	{
+		for (auto [ptr, bytes] : cache.remote)
+		{
+			give_back(cache, ptr, bytes);
+		}
+		cache.live -= cache.remote.size();
+		cache.remote.clear();
+		cache.has_remote.store(false, std::memory_order_relaxed);
+	}
+
+public:
+	static void* allocate(size_t bytes)
+	{
+		ThreadCache& local = thread_cache();
+		if (local.cache == nullptr)
+		{
+			local.cache = new Cache();
+		}
+		Cache& cache = *local.cache;
+
+		if (cache.has_remote.load(std::memory_order_acquire))
+		{
+			std::lock_guard<std::mutex> guard(cache.mutex_remote);
+			drain(cache);
+		}
+
+		bytes += sizeof(Header);
+		size_t c = class_of(bytes);
+		void* ptr{};
+		if (c < num_classes && cache.free[c] != nullptr)
+		{
+			ptr = std::exchange(cache.free[c], cache.free[c]->next);
+		}
+		else
+		{
+			// a whole class slot, so that the frame can be reused for any size of its class
+			ptr = cache.resource.allocate(c < num_classes ? min_class << c : bytes, alignment);
+		}
+
+		Header* header = static_cast<Header*>(ptr);
+		header->owner = &cache;
+		++cache.live;
+		return header + 1;
+	}
+
+	static void deallocate(void* ptr, size_t bytes)
+	{
+		Header* header = static_cast<Header*>(ptr) - 1;
+		Cache* owner = header->owner;
+		bytes += sizeof(Header);
+
+		if (owner == thread_cache().cache)
+		{
+			give_back(*owner, header, bytes);
+			--owner->live;
+			return;
+		}
+
+		// the owner counts the frame as freed when it drains the remote frames
+		bool last{};
+		{
+			std::lock_guard<std::mutex> guard(owner->mutex_remote);
+			if (owner->alive)
+			{
+				owner->remote.emplace_back(header, bytes);
+				owner->has_remote.store(true, std::memory_order_release);
+			}
+			else
+			{
+				give_back(*owner, header, bytes);
+				last = --owner->live == 0;
+			}
+		}
+		if (last)
+		{
+			delete owner;
+		}
+	}
+
+	// frames created by the calling thread and not freed yet, frames freed by other
+	// threads count until the calling thread allocates again
+	static size_t live_frames()
+	{
+		ThreadCache& local = thread_cache();
+		return local.cache != nullptr ? local.cache->live : 0;
+	}
+};
+
+// base for promise types whose frames come from the FramePool
+struct PooledFrame
+{
+	static void* operator new(size_t bytes)
+	{
+		return FramePool::allocate(bytes);
+	}
+
+	static void operator delete(void* ptr, size_t bytes)
+	{
+		FramePool::deallocate(ptr, bytes);
+	}
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <stdexcept>
+#include "ObjectPool.hpp"
+#include "ConcurrentObjectPool.hpp"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/* NUMA nodes of the machine, a machine without NUMA has one node */
+
+// number of the highest online node plus one, from /sys/devices/system/node/online ("0-1,3")
+inline size_t numa_node_count()
+{
+	size_t count = 1;
+#ifdef __linux__
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string range;
+	while (std::getline(online, range, ','))
+	{
+		size_t last = range.find_last_of('-');
+		try
+		{
+			count = std::max<size_t>(count, std::stoul(last == std::string::npos ? range : range.substr(last + 1)) + 1);
+		}
+		catch (const std::exception&)
+		{
+			return 1;
+		}
+	}
+#endif
+	return count;
+}
+
+// node of the CPU the calling thread runs on, 0 if unknown
+inline size_t current_numa_node()
+{
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29)
+	unsigned cpu = 0;
+	unsigned node = 0;
+	if (getcpu(&cpu, &node) == 0)
+	{
+		return node;
+	}
+#endif
+	return 0;
+}
+
+/* One lock-free pool per NUMA node, the slots of each are bound to their node.
+   An allocation is served by the node of the calling CPU, other nodes are only
+   used when that one is full. free() finds the owning node by address, so an
+   object can be freed from any thread. On a machine without NUMA, or where the
+   kernel refuses mbind, the slots simply stay where the OS puts them; is_bound()
+   tells which nodes got their slots bound. */
+
+template<typename T>
+class NumaObjectPool
+{
+private:
+	std::vector<std::unique_ptr<ConcurrentObjectPool<T>>> nodes;
+
+public:
+	// size is the capacity of every node
+	NumaObjectPool(size_t size = default_size, PoolOptions options = {}, size_t num_nodes = numa_node_count())
+	{
+		if (num_nodes == 0)
+		{
+			throw std::invalid_argument("A pool needs at least one node!\n");
+		}
+		for (size_t n = 0; n < num_nodes; ++n)
+		{
+			options.numa_node = static_cast<int>(n);
+			nodes.push_back(std::make_unique<ConcurrentObjectPool<T>>(size, options));
+		}
+	}
+
+	NumaObjectPool(const NumaObjectPool&) = delete;
+	NumaObjectPool& operator=(const NumaObjectPool&) = delete;
+
+	template<typename... Args>
+	T& alloc(Args&&... args)
+	{
+		T* ptr = try_alloc(std::forward<Args>(args)...);
+		if (ptr == nullptr)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		return *ptr;
+	}
+
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		return try_alloc_on(current_numa_node() % nodes.size(), std::forward<Args>(args)...);
+	}
+
+	// starts with the given node and goes on with the next ones while they are full
+	template<typename... Args>
+	T* try_alloc_on(size_t node, Args&&... args)
+	{
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			if (T* ptr = nodes[(node + i) % nodes.size()]->try_alloc(args...))
+			{
+				return ptr;
+			}
+		}
+		return nullptr;
+	}
+
+	void free(T& object)
+	{
+		nodes[node_of(object)]->free(object);
+	}
+
+	// node whose slots hold the object
+	size_t node_of(const T& object) const
+	{
+		for (size_t n = 0; n < nodes.size(); ++n)
+		{
+			if (nodes[n]->owns(object))
+			{
+				return n;
+			}
+		}
+		throw std::out_of_range("Could not free object!\n");
+	}
+
+	size_t num_nodes() const
+	{
+		return nodes.size();
+	}
+
+	size_t num_free() const
+	{
+		size_t result = 0;
+		for (const auto& node : nodes)
+		{
+			result += node->num_free();
+		}
+		return result;
+	}
+
+	size_t num_free(size_t node) const
+	{
+		return nodes.at(node)->num_free();
+	}
+
+	// false if the slots of the node stay where the OS puts them
+	bool is_bound(size_t node) const
+	{
+		return nodes.at(node)->numa_bound();
+	}
+};
@@ -1,89 +1,1370 @@
 #pragma once
 
+#include <bit>
+#include <array>
+#include <bitset>
 #include <vector>
+#include <new>
+#include <span>
 #include <memory>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include "PoolStats.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 static const size_t default_size = 10;
+static const size_t cache_line_size = 64;
+static const size_t huge_page_size = 2 << 20;
+
+struct PoolOptions
+{
+	bool growable = false;				// chain a new chunk, twice as big as the last one, instead of throwing when full
+	size_t alignment = 0;				// alignment of every slot, alignof(T) if smaller
+	bool cache_line_padding = false;	// give every object its own cache lines, no false sharing between slots
+	bool lazy_commit = false;			// reserve big chunks with mmap, pages are committed when first touched
+	int numa_node = -1;					// place the slots on this NUMA node, implies lazy_commit
+};
+
+/* Index of a slot and its generation packed into 32 bits, half the size of a pointer.
+   The generation changes every time the slot is freed and wraps: a handle kept while
+   its slot is reused a multiple of 2^generation_bits (4096) times looks valid again.
+   The free list hands a freed slot out first, so one object churning reuses the same
+   slot over and over; the 12 generation bits keep that wrap far away and leave 20 bits
+   for about a million slots. Moving index_bits trades one for the other. */
+
+struct PoolHandle
+{
+	static constexpr uint32_t index_bits = 20;
+	static constexpr uint32_t generation_bits = 32 - index_bits;
+	static constexpr uint32_t max_index = (uint32_t(1) << index_bits) - 1;	// the index of the invalid handle, no slot has it
+	static constexpr uint32_t generation_mask = (uint32_t(1) << generation_bits) - 1;
+
+	uint32_t bits = max_index;
+
+	PoolHandle() = default;
+	PoolHandle(uint32_t index, uint32_t generation) : bits((index & max_index) | (generation & generation_mask) << index_bits) {}
+
+	uint32_t index() const
+	{
+		return bits & max_index;
+	}
+
+	uint32_t generation() const
+	{
+		return bits >> index_bits;
+	}
+
+	bool operator==(const PoolHandle& other) const = default;
+};
+
+// where an object was before compaction and where it is now
+struct Relocation
+{
+	PoolHandle before;
+	PoolHandle after;
+};
+
+/* slot layout shared by the pools */
+
+struct SlotLayout
+{
+	size_t alignment{};
+	size_t stride{};	// distance between two slots
+
+	SlotLayout(size_t object_size, size_t object_alignment, const PoolOptions& options)
+	{
+		alignment = std::max(object_alignment, options.alignment);
+		if (options.cache_line_padding)
+		{
+			alignment = std::max(alignment, cache_line_size);
+		}
+		if (!std::has_single_bit(alignment))
+		{
+			throw std::invalid_argument("Alignment must be a power of two!\n");
+		}
+		stride = (object_size + alignment - 1) / alignment * alignment;
+	}
+};
+
+/* memory aligned to more than the default new alignment, or mapped from the OS */
+
+class AlignedDeleter
+{
+public:
+	AlignedDeleter(size_t _alignment = alignof(std::max_align_t), size_t _mapped = 0, bool _numa_bound = false)
+		: alignment(_alignment), mapped(_mapped), bound(_numa_bound) {}
+
+	void operator()(char* ptr) const
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if (mapped != 0)
+		{
+			munmap(ptr, mapped);
+			return;
+		}
+#endif
+		::operator delete(ptr, std::align_val_t(alignment));
+	}
+
+	// true if the kernel accepted the NUMA policy of the mapping
+	bool numa_bound() const
+	{
+		return bound;
+	}
+
+private:
+	size_t alignment{};
+	size_t mapped{};	// length of the mapping, 0 if the memory came from operator new
+	bool bound{};
+};
+
+using AlignedBuffer = std::unique_ptr<char[], AlignedDeleter>;
+
+inline AlignedBuffer make_aligned_buffer(size_t bytes, size_t alignment)
+{
+	return AlignedBuffer(static_cast<char*>(::operator new(bytes, std::align_val_t(alignment))), AlignedDeleter(alignment));
+}
+
+// asks for the pages of [begin, begin + length) to be placed on one NUMA node when first
+// touched; the node is preferred, not required, so a full node falls back to the others
+// instead of failing the page fault. false if the kernel has no NUMA support or no such node
+inline bool bind_to_numa_node(char* begin, size_t length, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	static const int mpol_preferred = 1;	// MPOL_PREFERRED of <numaif.h>
+	static const size_t mask_bits = 8 * sizeof(unsigned long);
+	unsigned long mask[1024 / mask_bits]{};
+	if (node < 0 || static_cast<size_t>(node) >= 8 * sizeof(mask))
+	{
+		return false;
+	}
+	mask[node / mask_bits] = 1ul << (node % mask_bits);
+	return syscall(SYS_mbind, begin, length, mpol_preferred, mask, 8 * sizeof(mask), 0) == 0;
+#else
+	return false;
+#endif
+}
 
-template<typename T>
+// Reserves address space only, a page is committed (and zeroed) when it is first touched.
+// The mapping starts on a huge page boundary and asks for transparent huge pages, so a
+// big pool needs fewer TLB entries. A buffer for a NUMA node is bound to the node, the
+// deleter's numa_bound() tells whether that worked. Small buffers and failed mappings use
+// operator new and are never bound.
+inline AlignedBuffer make_mapped_buffer(size_t bytes, size_t alignment, int numa_node = -1)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	if ((bytes >= huge_page_size || numa_node >= 0) && alignment <= huge_page_size)
+	{
+		size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		size_t length = (bytes + page - 1) / page * page;
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+		flags |= MAP_NORESERVE;
+#endif
+		// map one huge page more than needed and trim the ends to align the start
+		void* reserved = mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (reserved != MAP_FAILED)
+		{
+			char* raw = static_cast<char*>(reserved);
+			char* begin = raw + (huge_page_size - reinterpret_cast<uintptr_t>(raw) % huge_page_size) % huge_page_size;
+			if (begin != raw)
+			{
+				munmap(raw, begin - raw);
+			}
+			if (raw + length + huge_page_size != begin + length)
+			{
+				munmap(begin + length, raw + length + huge_page_size - (begin + length));
+			}
+#ifdef MADV_HUGEPAGE
+			madvise(begin, length, MADV_HUGEPAGE);
+#endif
+			bool bound = numa_node >= 0 && bind_to_numa_node(begin, length, numa_node);
+			return AlignedBuffer(begin, AlignedDeleter(alignment, length, bound));
+		}
+	}
+#endif
+	return make_aligned_buffer(bytes, alignment);
+}
+
+// gives the whole pages inside [begin, end) back to the OS, they read as zeroes when touched again
+inline size_t decommit_pages(char* begin, char* end)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page - 1) / page * page;
+	uintptr_t last = reinterpret_cast<uintptr_t>(end) / page * page;
+	if (first < last && madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) == 0)
+	{
+		return last - first;
+	}
+#endif
+	return 0;
+}
+
+/* N is the capacity known at compile time, 0 for a pool sized at run time */
+
+template<typename T, size_t N = 0, typename Stats = NoStats>
 class ObjectPool
 {
 private:
-	std::unique_ptr<char[]> pool;	// pool
-	std::vector<bool> usage;		// vector of booleans assossiated with pool
+	static const size_t npos = static_cast<size_t>(-1);
+
+	struct Chunk
+	{
+		AlignedBuffer memory;
+		size_t base{};		// index of the first slot
+		size_t capacity{};	// number of slots
+	};
+
+	// unused slots [begin, end) whose pages were given back, they keep no free list links
+	struct Run
+	{
+		size_t begin{};
+		size_t end{};
+	};
+
+	// an unused slot keeps the index of the next unused slot, so it must fit a size_t
+	SlotLayout layout;
+	size_t slot_size{};
+
+	std::vector<Chunk> chunks;		// pool, chunk k holds first * 2^k slots and is never moved
+	std::vector<Chunk*> by_address;	// chunks sorted by address, to find the owner of an object
+	std::vector<uint64_t> usage;	// occupancy bitmap assossiated with pool, one bit per slot
+	std::vector<uint32_t> generations;	// generation of every slot below the highest watermark so far, for handles
 	size_t size{};					// size of pool
-	T* data{};						// ptr to the head of pool
+	size_t first{};					// size of the first chunk
+	size_t used{};					// number of live objects
+	char* data{};					// ptr to the head of the first chunk
+	size_t head{ npos };			// first slot of the free list
+	size_t watermark{};				// slots from here on have never been used
+	std::vector<Run> released;		// decommitted runs, the lowest one last
+	std::vector<size_t> recycled;	// unused slots that still hold a constructed object
+	std::function<void(T&)> recycle_hook;
+	bool growable{};
+	bool lazy_commit{};
+	int numa_node{};
+	OBJECTPOOL_NO_UNIQUE_ADDRESS Stats pool_stats;
 
-public:
-	ObjectPool(size_t _size = default_size) : size(_size)
+	size_t chunk_of(size_t i) const
 	{
-		pool = std::make_unique<char[]>(sizeof(T) * size); // std::unique_ptr<char[]>(new char[sizeof(T) * size])
-		data = reinterpret_cast<T*>(pool.get());
-		usage.resize(size, false);
+		// chunk k starts at slot first * (2^k - 1)
+		return i < first ? 0 : std::bit_width(i / first + 1) - 1;
 	}
 
-	template<typename... Args>
-	T& alloc(Args&&... args)
+	char* address(size_t i)
+	{
+		if (i < first)
+		{
+			return data + i * slot_size;
+		}
+		size_t k = chunk_of(i);
+		return chunks[k].memory.get() + (i - chunks[k].base) * slot_size;
+	}
+
+	T* slot(size_t i)
+	{
+		return reinterpret_cast<T*>(address(i));
+	}
+
+	// index of the slot the object lives in, npos if the object is not from this pool
+	size_t index_of(const void* object) const
+	{
+		const char* ptr = static_cast<const char*>(object);
+		auto it = std::upper_bound(by_address.begin(), by_address.end(), ptr,
+			[](const char* p, const Chunk* chunk) { return std::less<const char*>()(p, chunk->memory.get()); });
+		if (it == by_address.begin())
+		{
+			return npos;
+		}
+
+		const Chunk* chunk = *(it - 1);
+		size_t offset = static_cast<size_t>(ptr - chunk->memory.get());
+		if (offset >= chunk->capacity * slot_size || offset % slot_size != 0)
+		{
+			return npos;
+		}
+		return chunk->base + offset / slot_size;
+	}
+
+	void add_chunk(size_t capacity)
+	{
+		Chunk& chunk = chunks.emplace_back();
+		chunk.memory = lazy_commit || numa_node >= 0 ? make_mapped_buffer(slot_size * capacity, layout.alignment, numa_node)
+			: make_aligned_buffer(slot_size * capacity, layout.alignment);
+		chunk.base = size;
+		chunk.capacity = capacity;
+
+		size += capacity;
+		usage.resize((size + word_bits - 1) / word_bits, 0);
+
+		by_address.clear();
+		for (Chunk& c : chunks)
+		{
+			by_address.push_back(&c);
+		}
+		std::sort(by_address.begin(), by_address.end(),
+			[](const Chunk* a, const Chunk* b) { return std::less<const char*>()(a->memory.get(), b->memory.get()); });
+	}
+
+	/* occupancy bitmap */
+
+	static const size_t word_bits = 64;
+
+	bool is_used(size_t i) const
+	{
+		return (usage[i / word_bits] >> (i % word_bits)) & 1;
+	}
+
+	void set_used(size_t i)
+	{
+		usage[i / word_bits] |= uint64_t(1) << (i % word_bits);
+		++used;
+	}
+
+	void set_unused(size_t i)
+	{
+		usage[i / word_bits] &= ~(uint64_t(1) << (i % word_bits));
+		--used;
+	}
+
+	static uint64_t bit_mask(size_t bit, size_t n)
+	{
+		return n == word_bits ? ~uint64_t(0) : ((uint64_t(1) << n) - 1) << bit;
+	}
+
+	// flips the bits of [begin, end) a word at a time
+	void flip_range(size_t begin, size_t end)
+	{
+		while (begin < end)
+		{
+			size_t bit = begin % word_bits;
+			size_t n = std::min(end - begin, word_bits - bit);
+			usage[begin / word_bits] ^= bit_mask(bit, n);
+			begin += n;
+		}
+	}
+
+	// marks the unused slots [begin, end) as used
+	void set_used_range(size_t begin, size_t end)
+	{
+		used += end - begin;
+		flip_range(begin, end);
+	}
+
+	// recycled slots and released runs are unused but not on the free list, flipping
+	// their bits hides them from scans for free slots, flipping them again shows them
+	void flip_off_list()
+	{
+		for (size_t i : recycled)
+		{
+			usage[i / word_bits] ^= uint64_t(1) << (i % word_bits);
+		}
+		for (const Run& run : released)
+		{
+			flip_range(run.begin, run.end);
+		}
+	}
+
+	// words past the watermark are always empty
+	size_t num_words() const
+	{
+		return (watermark + word_bits - 1) / word_bits;
+	}
+
+	/* free list, the next index is stored inside the unused slot itself */
+
+	size_t pop_free()
 	{
-		for (size_t i = 0; i < size; ++i)
+		if (head != npos)
 		{
-			if (usage[i] == false)
+			size_t i = head;
+			std::memcpy(&head, address(i), sizeof(size_t));
+			return i;
+		}
+		if (!released.empty())
+		{
+			size_t i = released.back().begin++;
+			if (released.back().begin == released.back().end)
+			{
+				released.pop_back();
+			}
+			return i;
+		}
+		if (watermark == size && !recycled.empty())
+		{
+			// out of empty slots, give up a recycled object before growing
+			size_t i = recycled.back();
+			recycled.pop_back();
+			slot(i)->~T();
+			return i;
+		}
+		if (watermark == size && growable)
+		{
+			add_chunk(first << chunks.size());
+		}
+		if (watermark < size)
+		{
+			// the slot may have been live before reset(), make its old handles stale
+			if (watermark == generations.size())
 			{
-				usage[i] = true;
-				T* ptr = new(data + i) T{ std::forward<Args>(args)... };
-				return *ptr;
+				generations.push_back(0);
 			}
+			++generations[watermark];
+			return watermark++;
 		}
-		throw std::out_of_range("ObjectPool is full!\n");
+		return npos;
 	}
 
-	void free(T& object)
+	void push_free(size_t i)
 	{
-		size_t i(-1);
+		std::memcpy(address(i), &head, sizeof(size_t));
+		head = i;
+	}
 
-		T* object_ptr = &object;
-		if (object_ptr >= data)
+	/* construction and destruction of the object in a slot */
+
+	static constexpr size_t max_handle_index = PoolHandle::max_index;
+
+	// index of the new object, npos if the pool is full
+	template<typename... Args>
+	size_t construct(Args&&... args)
+	{
+		typename Stats::Sample sample = pool_stats.sample();
+		size_t i = pop_free();
+		if (i == npos)
 		{
-			i = object_ptr - data;
+			pool_stats.on_failed_alloc();
+			return npos;
+		}
 
-#ifdef _DEBUG
-			std::cout << i;
-#endif // _DEBUG
+		try
+		{
+			new(slot(i)) T{ std::forward<Args>(args)... };
 		}
+		catch (...)
+		{
+			push_free(i);
+			throw;
+		}
+		set_used(i);
+		pool_stats.on_alloc(1, sample);
+		return i;
+	}
 
-		if (i < size && usage[i] == true)
+	// first free slot from i on
+	size_t next_hole(size_t i) const
+	{
+		for (size_t w = i / word_bits;; ++w)
 		{
-			usage[i] = false;
-			object_ptr->~T();
+			uint64_t holes = ~usage[w];
+			if (w == i / word_bits)
+			{
+				holes &= ~uint64_t(0) << (i % word_bits);
+			}
+			if (holes != 0)
+			{
+				return w * word_bits + std::countr_zero(holes);
+			}
 		}
-		else
+	}
+
+	void destroy(size_t i)
+	{
+		typename Stats::Sample sample = pool_stats.sample();
+		set_unused(i);
+		++generations[i];
+		slot(i)->~T();
+		push_free(i);
+		pool_stats.on_free(1, sample);
+	}
+
+	// constructs objects in the slots [begin, end) of one chunk, which are marked used
+	// already and are not on the free list
+	template<typename... Args>
+	void construct_run(size_t begin, size_t end, std::vector<T*>& objects, const Args&... args)
+	{
+		size_t i = begin;
+		try
 		{
-			throw std::out_of_range("Could not free object!\n");
+			if constexpr (sizeof...(Args) == 0 && std::is_trivially_default_constructible_v<T>)
+			{
+				// T{} only zeroes the object, do it for the whole run at once
+				std::memset(address(begin), 0, (end - begin) * slot_size);
+				for (; i < end; ++i)
+				{
+					objects.push_back(new(slot(i)) T);
+				}
+			}
+			else
+			{
+				for (; i < end; ++i)
+				{
+					objects.push_back(new(slot(i)) T{ args... });
+				}
+			}
+			pool_stats.on_alloc(end - begin);
+		}
+		catch (...)
+		{
+			// the objects constructed so far are destroyed by alloc_n()
+			pool_stats.on_alloc(i - begin);
+			for (; i < end; ++i)
+			{
+				set_unused(i);
+				push_free(i);
+			}
+			throw;
 		}
 	}
 
-	size_t num_free()
+	// constructs up to count objects in runs of free list slots, found a word at a time in the bitmap
+	template<typename... Args>
+	void construct_free_runs(size_t count, std::vector<T*>& objects, const Args&... args)
 	{
-		size_t num_free(0);
-		for (size_t i = 0; i < size; ++i)
+		std::vector<Run> runs;
+		flip_off_list();
+		for (size_t w = 0, last = num_words(); w < last && count > 0; ++w)
+		{
+			uint64_t holes = ~usage[w];
+			if ((w + 1) * word_bits > watermark)
+			{
+				holes &= bit_mask(0, watermark % word_bits);
+			}
+			while (holes != 0 && count > 0)
+			{
+				size_t bit = std::countr_zero(holes);
+				size_t n = std::min<size_t>(std::countr_one(holes >> bit), count);
+				size_t begin = w * word_bits + bit;
+				if (!runs.empty() && runs.back().end == begin)
+				{
+					runs.back().end += n;
+				}
+				else
+				{
+					runs.push_back({ begin, begin + n });
+				}
+				usage[w] |= bit_mask(bit, n);
+				used += n;
+				holes &= ~bit_mask(bit, n);
+				count -= n;
+			}
+		}
+		flip_off_list();
+
+		// unlink the claimed slots, the others keep their order
+		size_t prev = npos;
+		for (size_t i = head; i != npos;)
+		{
+			size_t next{};
+			std::memcpy(&next, address(i), sizeof(size_t));
+			if (!is_used(i))
+			{
+				prev = i;
+			}
+			else if (prev == npos)
+			{
+				head = next;
+			}
+			else
+			{
+				std::memcpy(address(prev), &next, sizeof(size_t));
+			}
+			i = next;
+		}
+
+		size_t r = 0;
+		try
+		{
+			for (; r < runs.size(); ++r)
+			{
+				construct_run(runs[r].begin, runs[r].end, objects, args...);
+			}
+		}
+		catch (...)
 		{
-			if (usage[i] == false)
+			// the failed run gave its slots back, so do the runs after it
+			for (++r; r < runs.size(); ++r)
 			{
-				++num_free;
+				for (size_t i = runs[r].begin; i < runs[r].end; ++i)
+				{
+					set_unused(i);
+					push_free(i);
+				}
 			}
+			throw;
 		}
-		return num_free;
 	}
 
-	~ObjectPool()
+public:
+	/* forward iterator over live objects, skips empty words of the bitmap */
+
+	class iterator
 	{
-		for (size_t i = 0; i < size; ++i)
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = T*;
+		using reference = T&;
+
+		iterator() = default;
+
+		T& operator*() const
+		{
+			return *pool->slot(word * word_bits + std::countr_zero(bits));
+		}
+
+		T* operator->() const
+		{
+			return &**this;
+		}
+
+		iterator& operator++()
+		{
+			bits &= bits - 1;
+			skip_empty();
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator old = *this;
+			++*this;
+			return old;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return word == other.word && bits == other.bits;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		friend class ObjectPool;
+
+		ObjectPool* pool{};
+		size_t word{};
+		uint64_t bits{};	// live slots of the current word that are not visited yet
+
+		iterator(ObjectPool* _pool, size_t _word) : pool(_pool), word(_word)
+		{
+			if (word < pool->num_words())
+			{
+				bits = pool->usage[word];
+				skip_empty();
+			}
+		}
+
+		void skip_empty()
 		{
-			if (usage[i] == true)
+			size_t last = pool->num_words();
+			while (bits == 0 && ++word < last)
 			{
-				T* object_ptr = data + i;
-				object_ptr->~T();
+				bits = pool->usage[word];
 			}
+			if (bits == 0)
+			{
+				word = last;
+			}
+		}
+	};
+
+	ObjectPool(size_t _size = default_size, PoolOptions options = {})
+		: layout(std::max(sizeof(T), sizeof(size_t)), alignof(T), options), growable(options.growable), lazy_commit(options.lazy_commit), numa_node(options.numa_node)
+	{
+		slot_size = layout.stride;
+		// a growable pool needs a non-empty first chunk to double
+		first = growable && _size == 0 ? 1 : _size;
+		add_chunk(first);
+		data = chunks[0].memory.get();
+	}
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	template<typename... Args>
+	T& alloc(Args&&... args)
+	{
+		T* ptr = try_alloc(std::forward<Args>(args)...);
+		if (ptr == nullptr)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		return *ptr;
+	}
+
+	// same as alloc(), but returns nullptr instead of throwing when the pool is full
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		size_t i = construct(std::forward<Args>(args)...);
+		return i != npos ? slot(i) : nullptr;
+	}
+
+	void free(T& object)
+	{
+		size_t i = index_of(&object);
+
+#ifdef _DEBUG
+		std::cout << i;
+#endif // _DEBUG
+
+		if (i < size && is_used(i))
+		{
+			destroy(i);
+		}
+		else
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+	}
+
+	/* bulk allocation, every object is constructed from the same arguments */
+
+	template<typename... Args>
+	std::vector<T*> alloc_n(size_t count, const Args&... args)
+	{
+		if (!growable && num_free() < count)
+		{
+			pool_stats.on_failed_alloc();
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+
+		std::vector<T*> objects;
+		objects.reserve(count);
+		try
+		{
+			while (objects.size() < count)
+			{
+				if (head != npos)
+				{
+					construct_free_runs(count - objects.size(), objects, args...);
+					continue;
+				}
+				if (!released.empty() || (watermark == size && !recycled.empty()))
+				{
+					// decommitted and recycled slots are taken one by one
+					objects.push_back(slot(construct(args...)));
+					continue;
+				}
+				if (watermark == size)
+				{
+					add_chunk(first << chunks.size());
+				}
+				size_t begin = watermark;
+				size_t chunk_end = chunks[chunk_of(begin)].base + chunks[chunk_of(begin)].capacity;
+				size_t end = std::min(chunk_end, begin + count - objects.size());
+				// only slots that were live before reset() need a new generation
+				for (size_t j = begin; j < std::min(end, generations.size()); ++j)
+				{
+					++generations[j];
+				}
+				generations.resize(std::max(generations.size(), end), 0);
+				watermark = end;
+				set_used_range(begin, end);
+				construct_run(begin, end, objects, args...);
+			}
+		}
+		catch (...)
+		{
+			for (T* object : objects)
+			{
+				destroy(index_of(object));
+			}
+			throw;
+		}
+		return objects;
+	}
+
+	// frees all objects or, if one of them can not be freed, none of them
+	void free_n(std::span<T* const> objects)
+	{
+		for (size_t n = 0; n < objects.size(); ++n)
+		{
+			size_t i = index_of(objects[n]);
+			if (i >= size || !is_used(i))
+			{
+				// also catches an object given twice, restore the bits cleared so far
+				for (size_t m = 0; m < n; ++m)
+				{
+					set_used(index_of(objects[m]));
+				}
+				throw std::out_of_range("Could not free object!\n");
+			}
+			set_unused(i);
+		}
+
+		for (T* object : objects)
+		{
+			size_t i = index_of(object);
+			++generations[i];
+			object->~T();
+			push_free(i);
+		}
+		pool_stats.on_free(objects.size());
+	}
+
+	/* compaction, moves the live objects into the first slots */
+
+	// references to moved objects dangle afterwards, handles are remapped with relocate();
+	// the table covers the slots a handle can name, objects beyond them have no handles
+	std::vector<Relocation> compact(bool decommit_tail = false)
+	{
+		static_assert(std::is_nothrow_move_constructible_v<T>, "compact() moves objects and can not roll back");
+		clear_recycled();
+
+		std::vector<Relocation> table(std::min(watermark, max_handle_index));
+		size_t dense = used;
+
+		for (size_t i = 0; i < std::min(dense, table.size()); ++i)
+		{
+			if (is_used(i))
+			{
+				table[i] = { { static_cast<uint32_t>(i), generations[i] }, { static_cast<uint32_t>(i), generations[i] } };
+			}
+		}
+
+		// fill the holes below dense with the objects above it, both found by word scans
+		size_t hole = 0;
+		for (size_t w = dense / word_bits, last = num_words(); w < last; ++w)
+		{
+			uint64_t bits = usage[w];
+			if (w == dense / word_bits)
+			{
+				bits &= ~uint64_t(0) << (dense % word_bits);
+			}
+			for (; bits != 0; bits &= bits - 1)
+			{
+				size_t from = w * word_bits + std::countr_zero(bits);
+				hole = next_hole(hole);
+
+				new(slot(hole)) T(std::move(*slot(from)));
+				slot(from)->~T();
+				set_used(hole);
+				set_unused(from);
+
+				// hole < from, so the new slot has a handle whenever the old one had
+				if (from < table.size())
+				{
+					table[from] = { { static_cast<uint32_t>(from), generations[from] }, { static_cast<uint32_t>(hole), generations[hole] } };
+				}
+				++generations[from];
+			}
+		}
+
+		// every slot from dense on is free again, nothing to keep in the free list
+		head = npos;
+		released.clear();
+		size_t old_watermark = watermark;
+		watermark = dense;
+
+		if (decommit_tail)
+		{
+			for (Chunk& chunk : chunks)
+			{
+				size_t begin = std::max(chunk.base, dense);
+				size_t end = std::min(chunk.base + chunk.capacity, old_watermark);
+				if (begin < end)
+				{
+					decommit_pages(address(begin), address(begin) + (end - begin) * slot_size);
+				}
+			}
+		}
+		return table;
+	}
+
+	// handle of the object after compact(), an invalid handle if it was stale already
+	static PoolHandle relocate(PoolHandle handle, const std::vector<Relocation>& table)
+	{
+		if (handle.index() < table.size() && table[handle.index()].before == handle)
+		{
+			return table[handle.index()].after;
+		}
+		return PoolHandle{};
+	}
+
+	/* handles, 4 bytes that can be checked in O(1) instead of references that may dangle */
+
+	// the pool itself is not limited, but only its first PoolHandle::max_index slots
+	// have handles; past them alloc_handle() throws std::length_error
+	template<typename... Args>
+	PoolHandle alloc_handle(Args&&... args)
+	{
+		size_t i = construct(std::forward<Args>(args)...);
+		if (i == npos)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		if (i >= max_handle_index)
+		{
+			destroy(i);
+			throw std::length_error("ObjectPool is too big for handles!\n");
+		}
+		return { static_cast<uint32_t>(i), generations[i] };
+	}
+
+	// nullptr if the object of the handle has been freed
+	T* get(PoolHandle handle)
+	{
+		size_t i = handle.index();
+		if (i < generations.size() && PoolHandle(handle.index(), generations[i]) == handle && is_used(i))
+		{
+			return slot(i);
+		}
+		return nullptr;
+	}
+
+	PoolHandle handle_of(T& object)
+	{
+		size_t i = index_of(&object);
+		if (i >= max_handle_index || !is_used(i))
+		{
+			throw std::out_of_range("No handle for object!\n");
+		}
+		return { static_cast<uint32_t>(i), generations[i] };
+	}
+
+	void free(PoolHandle handle)
+	{
+		if (get(handle) == nullptr)
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+		destroy(handle.index());
+	}
+
+	size_t num_free() const
+	{
+		return size - used;
+	}
+
+	size_t capacity() const
+	{
+		return size;
+	}
+
+	// true if options.numa_node was given and every chunk is bound to that node
+	bool numa_bound() const
+	{
+		return std::all_of(chunks.begin(), chunks.end(), [](const Chunk& c) { return c.memory.get_deleter().numa_bound(); });
+	}
+
+	// true if the object lies in one of the slots of this pool, whether it is live or not
+	bool owns(const T& object) const
+	{
+		return index_of(&object) != npos;
+	}
+
+	// true if the object is from this pool and has not been freed
+	bool is_live(const T& object) const
+	{
+		size_t i = index_of(&object);
+		return i != npos && is_used(i);
+	}
+
+	/* live objects */
+
+	template<typename F>
+	void for_each_live(F&& f)
+	{
+		for (size_t w = 0, last = num_words(); w < last; ++w)
+		{
+			for (uint64_t bits = usage[w]; bits != 0; bits &= bits - 1)
+			{
+				f(*slot(w * word_bits + std::countr_zero(bits)));
+			}
+		}
+	}
+
+	iterator begin()
+	{
+		return iterator(this, 0);
+	}
+
+	iterator end()
+	{
+		return iterator(this, num_words());
+	}
+
+	/* recycling, released objects stay constructed and keep the memory they own */
+
+	// called on every released object, for example to clear() its containers
+	void set_recycle_hook(std::function<void(T&)> hook)
+	{
+		recycle_hook = std::move(hook);
+	}
+
+	// a released object if there is one, a new T{ args... } otherwise
+	template<typename... Args>
+	T& acquire(Args&&... args)
+	{
+		if (recycled.empty())
+		{
+			return alloc(std::forward<Args>(args)...);
+		}
+		size_t i = recycled.back();
+		recycled.pop_back();
+		set_used(i);
+		pool_stats.on_alloc(1);
+		return *slot(i);
+	}
+
+	// like free(), but the object is not destroyed and comes back from acquire()
+	void release(T& object)
+	{
+		size_t i = index_of(&object);
+		if (i >= size || !is_used(i))
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+		if (recycle_hook)
+		{
+			try
+			{
+				recycle_hook(object);
+			}
+			catch (...)
+			{
+				destroy(i);
+				throw;
+			}
+		}
+		set_unused(i);
+		++generations[i];
+		recycled.push_back(i);
+		pool_stats.on_free(1);
+	}
+
+	size_t num_recycled() const
+	{
+		return recycled.size();
+	}
+
+	// destroys the released objects, their slots become empty
+	void clear_recycled()
+	{
+		for (size_t i : recycled)
+		{
+			slot(i)->~T();
+			push_free(i);
+		}
+		recycled.clear();
+	}
+
+	/* pages of unused slots */
+
+	// Gives every page that holds no live object back to the OS, returns the number of bytes.
+	// The unused slots on those pages leave the free list, they are handed out (and their
+	// pages committed again) after the slots that kept their pages. Runs in O(capacity).
+	size_t decommit_free_pages()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+		size_t bytes = 0;
+		clear_recycled();
+		released.clear();
+
+		for (Chunk& chunk : chunks)
+		{
+			size_t chunk_end = chunk.base + chunk.capacity;
+			size_t limit = std::min(chunk_end, watermark);
+			if (limit < chunk_end)
+			{
+				// never used slots have no links, their pages can simply go
+				size_t begin = std::max(chunk.base, watermark);
+				bytes += decommit_pages(address(begin), address(begin) + (chunk_end - begin) * slot_size);
+			}
+
+			for (size_t i = chunk.base; i < limit;)
+			{
+				if (is_used(i))
+				{
+					++i;
+					continue;
+				}
+				size_t end = i;
+				while (end < limit && !is_used(end))
+				{
+					++end;
+				}
+
+				// only the slots whose link lies on a decommitted page leave the free list
+				uintptr_t run_begin = reinterpret_cast<uintptr_t>(address(i));
+				uintptr_t first_page = (run_begin + page - 1) / page * page;
+				uintptr_t last_page = (run_begin + (end - i) * slot_size) / page * page;
+				if (first_page < last_page)
+				{
+					uintptr_t link_end = run_begin + sizeof(size_t);
+					size_t lo = i + (link_end > first_page ? 0 : (first_page - link_end) / slot_size + 1);
+					size_t hi = i + (last_page - run_begin + slot_size - 1) / slot_size;
+					bytes += decommit_pages(reinterpret_cast<char*>(first_page), reinterpret_cast<char*>(last_page));
+					if (lo < hi)
+					{
+						released.push_back({ lo, hi });
+					}
+				}
+				i = end;
+			}
+		}
+
+		// relink the remaining unused slots, the lowest one first
+		std::reverse(released.begin(), released.end());
+		head = npos;
+		size_t r = 0;
+		for (size_t i = watermark; i-- > 0;)
+		{
+			while (r < released.size() && i < released[r].begin)
+			{
+				++r;
+			}
+			if (r < released.size() && i < released[r].end)
+			{
+				i = released[r].begin;
+				continue;
+			}
+			if (!is_used(i))
+			{
+				push_free(i);
+			}
+		}
+		return bytes;
+#else
+		return 0;
+#endif
+	}
+
+	/* statistics, all zero unless Stats is PoolStats */
+
+	PoolStatsSnapshot stats() const
+	{
+		return pool_stats.snapshot();
+	}
+
+	// times every rate-th alloc and free, 0 stops timing
+	void set_stats_sample_rate(size_t rate)
+	{
+		pool_stats.set_sample_rate(rate);
+	}
+
+	/* release every object at once */
+
+	// not O(1): the occupancy words below the watermark are cleared, one store per 64
+	// slots handed out since the last reset() or compact(), whatever the capacity.
+	// No per-object work if T is trivially destructible, otherwise the live slots are
+	// visited with bit scans over the same words
+	void reset()
+	{
+		destroy_all();
+		std::fill(usage.begin(), usage.begin() + num_words(), 0);
+		pool_stats.on_free(used);
+		used = 0;
+		head = npos;
+		released.clear();
+		recycled.clear();
+		watermark = 0;
+	}
+
+	~ObjectPool()
+	{
+		destroy_all();
+	}
+
+private:
+	void destroy_all()
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			for_each_live([](T& object) { object.~T(); });
+			for (size_t i : recycled)
+			{
+				slot(i)->~T();
+			}
+		}
+	}
+};
+
+/* Pool with compile-time capacity, storage and occupancy live inside the object.
+   No heap allocations, so it can sit on the stack or be constant-initialized
+   as a global (constinit ObjectPool<T, 16> pool;). */
+
+template<typename T, size_t N, typename Stats>
+	requires (N != 0)
+class ObjectPool<T, N, Stats>
+{
+private:
+	static_assert(std::is_same_v<Stats, NoStats>, "A pool with compile-time capacity keeps no statistics");
+
+	static const size_t npos = static_cast<size_t>(-1);
+
+	// an unused slot keeps the index of the next unused slot, so it must fit a size_t
+	struct Slot
+	{
+		alignas(T) unsigned char bytes[sizeof(T) > sizeof(size_t) ? sizeof(T) : sizeof(size_t)];
+	};
+
+	std::array<Slot, N> pool{};		// pool
+	std::bitset<N> usage{};			// bitset assossiated with pool
+	size_t used{};					// number of live objects
+	size_t head{ npos };			// first slot of the free list
+	size_t watermark{};				// slots from here on have never been used
+
+	T* slot(size_t i)
+	{
+		return reinterpret_cast<T*>(pool[i].bytes);
+	}
+
+	size_t pop_free()
+	{
+		if (head != npos)
+		{
+			size_t i = head;
+			std::memcpy(&head, pool[i].bytes, sizeof(size_t));
+			return i;
+		}
+		if (watermark < N)
+		{
+			return watermark++;
+		}
+		return npos;
+	}
+
+	void push_free(size_t i)
+	{
+		std::memcpy(pool[i].bytes, &head, sizeof(size_t));
+		head = i;
+	}
+
+public:
+	constexpr ObjectPool() = default;
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	template<typename... Args>
+	T& alloc(Args&&... args)
+	{
+		T* ptr = try_alloc(std::forward<Args>(args)...);
+		if (ptr == nullptr)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		return *ptr;
+	}
+
+	template<typename... Args>
+	T* try_alloc(Args&&... args)
+	{
+		size_t i = pop_free();
+		if (i == npos)
+		{
+			return nullptr;
+		}
+
+		T* ptr{};
+		try
+		{
+			ptr = new(slot(i)) T{ std::forward<Args>(args)... };
+		}
+		catch (...)
+		{
+			push_free(i);
+			throw;
+		}
+		usage.set(i);
+		++used;
+		return ptr;
+	}
+
+	void free(T& object)
+	{
+		size_t i = index_of(object);
+		if (i < N && usage.test(i))
+		{
+			usage.reset(i);
+			--used;
+			object.~T();
+			push_free(i);
+		}
+		else
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+	}
+
+	size_t num_free() const
+	{
+		return N - used;
+	}
+
+	static constexpr size_t capacity()
+	{
+		return N;
+	}
+
+	bool owns(const T& object) const
+	{
+		return index_of(object) != npos;
+	}
+
+	template<typename F>
+	void for_each_live(F&& f)
+	{
+		for (size_t i = 0; i < watermark; ++i)
+		{
+			if (usage.test(i))
+			{
+				f(*slot(i));
+			}
+		}
+	}
+
+	void reset()
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			for_each_live([](T& object) { object.~T(); });
+		}
+		usage.reset();	// N / 64 word stores
+		used = 0;
+		head = npos;
+		watermark = 0;
+	}
+
+	~ObjectPool()
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			for_each_live([](T& object) { object.~T(); });
+		}
+	}
+
+private:
+	size_t index_of(const T& object) const
+	{
+		const unsigned char* ptr = reinterpret_cast<const unsigned char*>(&object);
+		const unsigned char* begin = pool[0].bytes;
+		if (std::less<const unsigned char*>()(ptr, begin) || !std::less<const unsigned char*>()(ptr, begin + sizeof(pool)))
+		{
+			return npos;
 		}
+		size_t offset = static_cast<size_t>(ptr - begin);
+		return offset % sizeof(Slot) == 0 ? offset / sizeof(Slot) : npos;
 	}
 };
\ No newline at end of file
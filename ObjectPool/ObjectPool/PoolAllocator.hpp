@@ -0,0 +1,152 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include "ObjectPool.hpp"
+
+/* uninitialized storage for one object of the given size */
+
+template<size_t Size, size_t Align>
+struct RawSlot
+{
+	alignas(Align) unsigned char bytes[Size];
+
+	RawSlot() {}	// leaves the bytes uninitialized
+};
+
+/* growable slabs of fixed-size slots, one slab per size and alignment */
+
+class SlabArena
+{
+private:
+	struct SlabBase
+	{
+		size_t size{};
+		size_t alignment{};
+
+		virtual ~SlabBase() = default;
+	};
+
+	template<size_t Size, size_t Align>
+	struct Slab : SlabBase
+	{
+		ObjectPool<RawSlot<Size, Align>> pool;
+
+		Slab(size_t chunk_size) : pool(chunk_size, { .growable = true })
+		{
+			this->size = Size;
+			this->alignment = Align;
+		}
+	};
+
+	std::vector<std::unique_ptr<SlabBase>> slabs;
+	size_t chunk_size{};
+
+public:
+	SlabArena(size_t _chunk_size = 64) : chunk_size(_chunk_size) {}
+
+	template<size_t Size, size_t Align>
+	ObjectPool<RawSlot<Size, Align>>& slab()
+	{
+		for (std::unique_ptr<SlabBase>& slab : slabs)
+		{
+			if (slab->size == Size && slab->alignment == Align)
+			{
+				return static_cast<Slab<Size, Align>*>(slab.get())->pool;
+			}
+		}
+		auto slab = std::make_unique<Slab<Size, Align>>(chunk_size);
+		ObjectPool<RawSlot<Size, Align>>& pool = slab->pool;
+		slabs.push_back(std::move(slab));
+		return pool;
+	}
+};
+
+/* Standard allocator over slab pools.
+   Single objects, such as the nodes of std::list and std::map, come from a slab
+   in O(1); arrays go to operator new. Every default-constructed allocator owns a
+   new arena, copies and rebinds share it. An arena is as thread-safe as a container. */
+
+template<typename T>
+class PoolAllocator
+{
+private:
+	template<typename U>
+	friend class PoolAllocator;
+
+	using Slot = RawSlot<sizeof(T), alignof(T)>;
+
+	std::shared_ptr<SlabArena> arena;
+	ObjectPool<Slot>* slab{};	// looked up in the arena on first use
+
+	ObjectPool<Slot>& get_slab()
+	{
+		if (slab == nullptr)
+		{
+			slab = &arena->template slab<sizeof(T), alignof(T)>();
+		}
+		return *slab;
+	}
+
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+	using is_always_equal = std::false_type;
+
+	template<typename U>
+	struct rebind
+	{
+		using other = PoolAllocator<U>;
+	};
+
+	PoolAllocator() : arena(std::make_shared<SlabArena>()) {}
+
+	PoolAllocator(std::shared_ptr<SlabArena> _arena) : arena(std::move(_arena)) {}
+
+	// no move constructor, a moved-from container must still be able to allocate
+	PoolAllocator(const PoolAllocator& other) noexcept = default;
+
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) noexcept : arena(other.arena) {}
+
+	T* allocate(size_t n)
+	{
+		if (n != 1)
+		{
+			return std::allocator<T>().allocate(n);
+		}
+		return reinterpret_cast<T*>(get_slab().alloc().bytes);
+	}
+
+	void deallocate(T* ptr, size_t n)
+	{
+		if (n != 1)
+		{
+			std::allocator<T>().deallocate(ptr, n);
+			return;
+		}
+		get_slab().free(*reinterpret_cast<Slot*>(ptr));
+	}
+
+	// a copied container gets its own arena, so the two can be used from different threads
+	PoolAllocator select_on_container_copy_construction() const
+	{
+		return PoolAllocator();
+	}
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>& other) const
+	{
+		return arena == other.arena;
+	}
+
+	template<typename U>
+	bool operator!=(const PoolAllocator<U>& other) const
+	{
+		return arena != other.arena;
+	}
+};
\ No newline at end of file
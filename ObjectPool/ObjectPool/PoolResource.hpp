@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <memory_resource>
+#include "ObjectPool.hpp"
+#include "PoolAllocator.hpp"
+
+/* Memory resource with one growable ObjectPool slab per size class.
+   A request goes to the smallest class that fits its size and alignment,
+   requests bigger than the largest class go to the upstream resource.
+   Objects of different types share the slab of their class, either through
+   the memory_resource interface or through alloc<T>() and free(), which pick
+   the class at compile time.
+   Like std::pmr::unsynchronized_pool_resource it is not thread-safe. */
+
+template<size_t... Sizes>
+class BasicPoolResource : public std::pmr::memory_resource
+{
+public:
+	struct ClassStats
+	{
+		size_t size{};			// slot size of the class
+		size_t capacity{};		// slots allocated for the class
+		size_t used{};			// slots in use
+		size_t allocations{};	// requests served by the class so far
+	};
+
+	struct UpstreamStats
+	{
+		size_t used{};			// blocks in use
+		size_t allocations{};	// requests passed upstream so far
+	};
+
+	BasicPoolResource(std::pmr::memory_resource* _upstream = std::pmr::get_default_resource(), size_t chunk_bytes = 4096)
+		: upstream(_upstream), classes(((void)Sizes, chunk_bytes)...) {}
+
+	BasicPoolResource(const BasicPoolResource&) = delete;
+	BasicPoolResource& operator=(const BasicPoolResource&) = delete;
+
+	/* typed interface */
+
+	template<typename T, typename... Args>
+	T& alloc(Args&&... args)
+	{
+		constexpr size_t c = class_of(sizeof(T), alignof(T));
+		void* ptr{};
+		if constexpr (c == npos)
+		{
+			ptr = do_allocate(sizeof(T), alignof(T));
+		}
+		else
+		{
+			++std::get<c>(classes).allocations;
+			ptr = std::get<c>(classes).pool.alloc().bytes;
+		}
+
+		try
+		{
+			return *new(ptr) T{ std::forward<Args>(args)... };
+		}
+		catch (...)
+		{
+			do_deallocate(ptr, sizeof(T), alignof(T));
+			throw;
+		}
+	}
+
+	// the object must come from alloc<T>() with the same T
+	template<typename T>
+	void free(T& object)
+	{
+		constexpr size_t c = class_of(sizeof(T), alignof(T));
+		if constexpr (c != npos)
+		{
+			if (!std::get<c>(classes).pool.is_live(*reinterpret_cast<Slot<sizes[c]>*>(&object)))
+			{
+				throw std::out_of_range("Could not free object!\n");
+			}
+		}
+		object.~T();
+		do_deallocate(&object, sizeof(T), alignof(T));
+	}
+
+	// slot size of the class objects of type T go to, 0 if they go upstream
+	template<typename T>
+	static constexpr size_t size_class()
+	{
+		constexpr size_t c = class_of(sizeof(T), alignof(T));
+		return c == npos ? 0 : sizes[c];
+	}
+
+	std::vector<ClassStats> stats() const
+	{
+		std::vector<ClassStats> result;
+		collect(result, std::index_sequence_for<SizeClass<Sizes>...>());
+		return result;
+	}
+
+	UpstreamStats upstream_stats() const
+	{
+		return upstream_counts;
+	}
+
+	std::pmr::memory_resource* upstream_resource() const
+	{
+		return upstream;
+	}
+
+private:
+	static_assert(sizeof...(Sizes) > 0, "At least one size class is needed");
+
+	static constexpr std::array<size_t, sizeof...(Sizes)> sizes{ Sizes... };
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+	// a slot is aligned to the largest power of two dividing its size
+	template<size_t Size>
+	using Slot = RawSlot<Size, (Size & (~Size + 1))>;
+
+	template<size_t Size>
+	struct SizeClass
+	{
+		ObjectPool<Slot<Size>> pool;
+		size_t allocations{};
+
+		SizeClass(size_t chunk_bytes) : pool(std::max<size_t>(chunk_bytes / Size, 1), { .growable = true }) {}
+	};
+
+	std::pmr::memory_resource* upstream{};
+	std::tuple<SizeClass<Sizes>...> classes;
+	UpstreamStats upstream_counts{};
+
+	static constexpr size_t class_of(size_t bytes, size_t alignment)
+	{
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			if (bytes <= sizes[i] && alignment <= (sizes[i] & (~sizes[i] + 1)))
+			{
+				return i;
+			}
+		}
+		return npos;
+	}
+
+	template<size_t... I>
+	void* allocate_from(size_t c, std::index_sequence<I...>)
+	{
+		void* ptr{};
+		((c == I ? (++std::get<I>(classes).allocations, ptr = std::get<I>(classes).pool.alloc().bytes, 0) : 0), ...);
+		return ptr;
+	}
+
+	// a pointer the class did not hand out is a caller bug, it is dropped instead of
+	// thrown through deallocate(), which containers call from their destructors
+	template<size_t... I>
+	void free_to(size_t c, void* ptr, std::index_sequence<I...>)
+	{
+		((c == I ? (free_slot(std::get<I>(classes).pool, *static_cast<Slot<sizes[I]>*>(ptr)), 0) : 0), ...);
+	}
+
+	template<typename Pool, typename S>
+	static void free_slot(Pool& pool, S& slot)
+	{
+		bool live = pool.is_live(slot);
+		assert(live && "deallocate() with a pointer this resource did not allocate");
+		if (live)
+		{
+			pool.free(slot);
+		}
+	}
+
+	template<size_t... I>
+	void collect(std::vector<ClassStats>& result, std::index_sequence<I...>) const
+	{
+		(result.push_back({ sizes[I], std::get<I>(classes).pool.capacity(),
+			std::get<I>(classes).pool.capacity() - std::get<I>(classes).pool.num_free(), std::get<I>(classes).allocations }), ...);
+	}
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		size_t c = class_of(bytes, alignment);
+		if (c == npos)
+		{
+			++upstream_counts.used;
+			++upstream_counts.allocations;
+			return upstream->allocate(bytes, alignment);
+		}
+		return allocate_from(c, std::index_sequence_for<SizeClass<Sizes>...>());
+	}
+
+	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+	{
+		size_t c = class_of(bytes, alignment);
+		if (c == npos)
+		{
+			--upstream_counts.used;
+			upstream->deallocate(ptr, bytes, alignment);
+			return;
+		}
+		free_to(c, ptr, std::index_sequence_for<SizeClass<Sizes>...>());
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+using PoolResource = BasicPoolResource<8, 16, 32, 64, 128, 256, 512, 1024>;
\ No newline at end of file
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <bit>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+static const size_t num_latency_buckets = 64;	// bucket k counts latencies in [2^k, 2^(k+1)) ns
+
+struct PoolStatsSnapshot
+{
+	uint64_t allocations{};			// objects handed out
+	uint64_t frees{};				// objects given back
+	uint64_t failed_allocations{};	// requests the pool could not serve
+	uint64_t live{};				// objects in use
+	uint64_t high_water{};			// most objects in use at once
+	std::array<uint64_t, num_latency_buckets> alloc_latency{};
+	std::array<uint64_t, num_latency_buckets> free_latency{};
+};
+
+// an empty member that takes no space, MSVC ignores the standard attribute
+#if defined(_MSC_VER)
+#define OBJECTPOOL_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define OBJECTPOOL_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+/* Statistics policies of the pools, given as a template argument:
+   ObjectPool<T, 0, PoolStats> and ConcurrentObjectPool<T, PoolStats> count,
+   the default NoStats has empty hooks and takes no space. The pool with
+   compile-time capacity (N != 0) only takes NoStats. */
+
+// counters are relaxed atomics, a snapshot can be taken while other threads allocate
+class PoolStats
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	static constexpr bool enabled = true;
+
+	// start of a timed operation, only every sample_rate-th one is timed
+	struct Sample
+	{
+		clock::time_point start{};
+		bool timed{};
+	};
+
+	// 0 turns timing off, which is the default
+	void set_sample_rate(size_t rate)
+	{
+		sample_rate.store(rate, std::memory_order_relaxed);
+	}
+
+	Sample sample()
+	{
+		size_t rate = sample_rate.load(std::memory_order_relaxed);
+		if (rate == 0 || counter.fetch_add(1, std::memory_order_relaxed) % rate != 0)
+		{
+			return {};
+		}
+		return { clock::now(), true };
+	}
+
+	void on_alloc(size_t count)
+	{
+		on_alloc(count, Sample());
+	}
+
+	void on_alloc(size_t count, Sample sample)
+	{
+		allocations.fetch_add(count, std::memory_order_relaxed);
+		uint64_t now_live = live.fetch_add(count, std::memory_order_relaxed) + count;
+		uint64_t peak = high_water.load(std::memory_order_relaxed);
+		while (now_live > peak && !high_water.compare_exchange_weak(peak, now_live, std::memory_order_relaxed))
+		{
+		}
+		record(alloc_latency, sample);
+	}
+
+	void on_free(size_t count)
+	{
+		on_free(count, Sample());
+	}
+
+	void on_free(size_t count, Sample sample)
+	{
+		frees.fetch_add(count, std::memory_order_relaxed);
+		live.fetch_sub(count, std::memory_order_relaxed);
+		record(free_latency, sample);
+	}
+
+	void on_failed_alloc()
+	{
+		failed_allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	PoolStatsSnapshot snapshot() const
+	{
+		PoolStatsSnapshot result;
+		result.allocations = allocations.load(std::memory_order_relaxed);
+		result.frees = frees.load(std::memory_order_relaxed);
+		result.failed_allocations = failed_allocations.load(std::memory_order_relaxed);
+		result.live = live.load(std::memory_order_relaxed);
+		result.high_water = high_water.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < num_latency_buckets; ++i)
+		{
+			result.alloc_latency[i] = alloc_latency[i].load(std::memory_order_relaxed);
+			result.free_latency[i] = free_latency[i].load(std::memory_order_relaxed);
+		}
+		return result;
+	}
+
+private:
+	using Histogram = std::array<std::atomic<uint64_t>, num_latency_buckets>;
+
+	std::atomic<uint64_t> allocations{};
+	std::atomic<uint64_t> frees{};
+	std::atomic<uint64_t> failed_allocations{};
+	std::atomic<uint64_t> live{};
+	std::atomic<uint64_t> high_water{};
+	std::atomic<size_t> sample_rate{};
+	std::atomic<size_t> counter{};
+	Histogram alloc_latency{};
+	Histogram free_latency{};
+
+	static void record(Histogram& histogram, Sample sample)
+	{
+		if (!sample.timed)
+		{
+			return;
+		}
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - sample.start).count();
+		uint64_t latency = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+		histogram[latency > 0 ? std::bit_width(latency) - 1 : 0].fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+class NoStats
+{
+public:
+	static constexpr bool enabled = false;
+
+	struct Sample
+	{
+	};
+
+	void set_sample_rate(size_t) {}
+	Sample sample() { return {}; }
+	void on_alloc(size_t) {}
+	void on_alloc(size_t, Sample) {}
+	void on_free(size_t) {}
+	void on_free(size_t, Sample) {}
+	void on_failed_alloc() {}
+	PoolStatsSnapshot snapshot() const { return {}; }
+};
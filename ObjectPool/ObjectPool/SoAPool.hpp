@@ -0,0 +1,269 @@
+#pragma once
+
+#include <new>
+#include <span>
+#include <array>
+#include <tuple>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include "ObjectPool.hpp"
+
+/* Structure-of-arrays pool, every field of an element lives in its own array.
+   The live elements are always the first size() entries of every array: free()
+   moves the last element into the hole. field<I>() is then a dense span over
+   one member of all elements, loops over it touch nothing else and vectorize.
+   Elements are named by handles, which survive the moves; references and
+   pointers into the arrays do not survive a free().
+
+   SoAPool<int, int> points(1000);		// Point{ m_x, m_y }
+   PoolHandle p = points.alloc(1, 2);
+   for (int& x : points.field<0>()) x += 1; */
+
+template<typename... Fields>
+class SoAPool
+{
+public:
+	template<size_t I>
+	using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+	// the element of a handle, valid until the next free()
+	class Ref
+	{
+	public:
+		template<size_t I>
+		Field<I>& get() const
+		{
+			return pool->template column<I>()[dense];
+		}
+
+	private:
+		friend class SoAPool;
+
+		SoAPool* pool{};
+		size_t dense{};
+
+		Ref(SoAPool* _pool, size_t _dense) : pool(_pool), dense(_dense) {}
+	};
+
+	SoAPool(size_t _size = default_size) : max_size(_size)
+	{
+		static_assert(sizeof...(Fields) > 0, "At least one field is needed");
+		static_assert((std::is_nothrow_move_assignable_v<Fields> && ...), "free() moves elements and can not roll back");
+
+		if (max_size > PoolHandle::max_index)
+		{
+			throw std::length_error("ObjectPool is too big for handles!\n");
+		}
+		allocate_columns(std::index_sequence_for<Fields...>());
+		dense_of.resize(max_size);
+		slot_of.resize(max_size);
+		generations.resize(max_size, 0);
+	}
+
+	SoAPool(const SoAPool&) = delete;
+	SoAPool& operator=(const SoAPool&) = delete;
+
+	// every field is constructed from its argument, or value-initialized without arguments
+	template<typename... Args>
+	PoolHandle alloc(Args&&... args)
+	{
+		static_assert(sizeof...(Args) == 0 || sizeof...(Args) == sizeof...(Fields), "One argument per field");
+
+		if (used == max_size)
+		{
+			throw std::out_of_range("ObjectPool is full!\n");
+		}
+		construct(used, std::index_sequence_for<Fields...>(), std::forward<Args>(args)...);
+
+		uint32_t slot = pop_free();
+		dense_of[slot] = static_cast<uint32_t>(used);
+		slot_of[used] = slot;
+		++used;
+		return { slot, generations[slot] };
+	}
+
+	void free(PoolHandle handle)
+	{
+		if (!is_live(handle))
+		{
+			throw std::out_of_range("Could not free object!\n");
+		}
+
+		size_t dense = dense_of[handle.index()];
+		size_t last = used - 1;
+		move_last(dense, last, std::index_sequence_for<Fields...>());
+
+		slot_of[dense] = slot_of[last];
+		dense_of[slot_of[dense]] = static_cast<uint32_t>(dense);
+		--used;
+
+		++generations[handle.index()];
+		push_free(handle.index());
+	}
+
+	bool is_live(PoolHandle handle) const
+	{
+		uint32_t i = handle.index();
+		return i < watermark && PoolHandle(i, generations[i]) == handle && dense_of[i] < used && slot_of[dense_of[i]] == i;
+	}
+
+	Ref at(PoolHandle handle)
+	{
+		if (!is_live(handle))
+		{
+			throw std::out_of_range("No object for handle!\n");
+		}
+		return Ref(this, dense_of[handle.index()]);
+	}
+
+	// nullptr if the element of the handle has been freed
+	template<size_t I>
+	Field<I>* get(PoolHandle handle)
+	{
+		return is_live(handle) ? column<I>() + dense_of[handle.index()] : nullptr;
+	}
+
+	/* dense access, position i is in [0, size()) and changes when elements are freed */
+
+	template<size_t I>
+	std::span<Field<I>> field()
+	{
+		return std::span<Field<I>>(column<I>(), used);
+	}
+
+	template<size_t I>
+	std::span<const Field<I>> field() const
+	{
+		return std::span<const Field<I>>(column<I>(), used);
+	}
+
+	PoolHandle handle_at(size_t i) const
+	{
+		if (i >= used)
+		{
+			throw std::out_of_range("No object at position!\n");
+		}
+		return { slot_of[i], generations[slot_of[i]] };
+	}
+
+	// number of live elements, the dense positions are [0, size())
+	size_t size() const
+	{
+		return used;
+	}
+
+	size_t num_free() const
+	{
+		return max_size - used;
+	}
+
+	size_t capacity() const
+	{
+		return max_size;
+	}
+
+	~SoAPool()
+	{
+		destroy_all(std::index_sequence_for<Fields...>());
+	}
+
+private:
+	static const uint32_t npos = static_cast<uint32_t>(-1);
+
+	// every array starts on its own cache line
+	static constexpr size_t column_alignment = std::max({ cache_line_size, alignof(Fields)... });
+
+	std::array<AlignedBuffer, sizeof...(Fields)> columns;
+	std::vector<uint32_t> dense_of;		// position of the element of every slot, the next free slot for a free one
+	std::vector<uint32_t> slot_of;		// slot of the element at every position
+	std::vector<uint32_t> generations;	// generation of every slot, changes when its element is freed
+	size_t max_size{};					// size of pool
+	size_t used{};						// number of live elements
+	uint32_t head{ npos };				// first slot of the free list
+	uint32_t watermark{};				// slots from here on have never been used
+
+	template<size_t I>
+	Field<I>* column()
+	{
+		return std::assume_aligned<column_alignment>(reinterpret_cast<Field<I>*>(columns[I].get()));
+	}
+
+	template<size_t I>
+	const Field<I>* column() const
+	{
+		return std::assume_aligned<column_alignment>(reinterpret_cast<const Field<I>*>(columns[I].get()));
+	}
+
+	template<size_t... I>
+	void allocate_columns(std::index_sequence<I...>)
+	{
+		((columns[I] = make_aligned_buffer(std::max<size_t>(max_size, 1) * sizeof(Field<I>), column_alignment)), ...);
+	}
+
+	uint32_t pop_free()
+	{
+		if (head != npos)
+		{
+			uint32_t slot = head;
+			head = dense_of[slot];
+			return slot;
+		}
+		return watermark++;
+	}
+
+	void push_free(uint32_t slot)
+	{
+		dense_of[slot] = head;
+		head = slot;
+	}
+
+	template<size_t... I, typename... Args>
+	void construct(size_t dense, std::index_sequence<I...>, Args&&... args)
+	{
+		size_t done = 0;
+		try
+		{
+			if constexpr (sizeof...(Args) == 0)
+			{
+				((new(column<I>() + dense) Field<I>(), ++done), ...);
+			}
+			else
+			{
+				((new(column<I>() + dense) Field<I>(std::forward<Args>(args)), ++done), ...);
+			}
+		}
+		catch (...)
+		{
+			((I < done ? std::destroy_at(column<I>() + dense) : void()), ...);
+			throw;
+		}
+	}
+
+	template<size_t... I>
+	void move_last(size_t dense, size_t last, std::index_sequence<I...>)
+	{
+		if (dense != last)
+		{
+			((column<I>()[dense] = std::move(column<I>()[last])), ...);
+		}
+		(std::destroy_at(column<I>() + last), ...);
+	}
+
+	template<size_t... I>
+	void destroy_all(std::index_sequence<I...>)
+	{
+		auto destroy = [this]<size_t J>()
+		{
+			if constexpr (!std::is_trivially_destructible_v<Field<J>>)
+			{
+				std::destroy(column<J>(), column<J>() + used);
+			}
+		};
+		(destroy.template operator()<I>(), ...);
+	}
+};
@@ -1,6 +1,9 @@
 #include "gtest/gtest.h"
 #include "../SharedPtr/SharedPtr.hpp"
 
+#include <thread>
+#include <vector>
+
 #include <crtdbg.h> // windowsmen only
 
 class MemoryLeaksTests : public::testing::Test
@@ -37,6 +40,16 @@ TEST_F(Constructor, Default)
 	EXPECT_EQ(sp.operator bool(), false);
 }
 
+TEST_F(Constructor, Nullptr)
+{
+	SharedPTR<int> sp1(nullptr);
+	SharedPTR<int> sp2 = nullptr;
+	auto none = []() -> SharedPTR<int> { return nullptr; };
+	EXPECT_EQ(sp1.get(), nullptr);
+	EXPECT_EQ(sp2.reference_count(), 0);
+	EXPECT_EQ(none().operator bool(), false);
+}
+
 TEST_F(Constructor, WithParameters)
 {
 	char* p = new char;
@@ -426,4 +439,137 @@ TEST_F(Deleter, Custom_ManyShared)
 	SharedPTR<Custom, CustomDeleter> sp3 = sp2;
 	SharedPTR<Custom, CustomDeleter> sp4(std::move(sp3));
 	SharedPTR<Custom, CustomDeleter> sp5 = std::move(sp4);
-}
\ No newline at end of file
+}
+
+class CountPolicy : public MemoryLeaksTests {};
+
+TEST_F(CountPolicy, Local)
+{
+	int* p = new int(1);
+	SharedPTR<int, std::default_delete<int>, LocalCount> sp1(p);
+	SharedPTR<int, std::default_delete<int>, LocalCount> sp2(sp1);
+	EXPECT_EQ(sp2.reference_count(), 2);
+	sp1.release();
+	EXPECT_EQ(sp2.reference_count(), 1);
+	EXPECT_EQ(*sp2, 1);
+}
+
+TEST_F(CountPolicy, Custom_Local)
+{
+	Custom* custom = new Custom(new int{ 0 }, new double{ 0.0 });
+	SharedPTR<Custom, CustomDeleter, LocalCount> sp1(custom);
+	SharedPTR<Custom, CustomDeleter, LocalCount> sp2 = sp1;
+	EXPECT_EQ(sp1.reference_count(), 2);
+}
+
+TEST_F(CountPolicy, AtomicCopiesOnManyThreads)
+{
+	static const int num_threads = 8;
+	static const int copies = 10000;
+
+	SharedPTR<A> sp(new A{ 1, 1.0 });
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < num_threads; ++t)
+		{
+			threads.emplace_back([&sp]
+			{
+				for (int i = 0; i < copies; ++i)
+				{
+					SharedPTR<A> copy(sp);
+					EXPECT_EQ(copy->i, 1);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+	EXPECT_EQ(sp.reference_count(), 1);
+}
+
+TEST_F(CountPolicy, AtomicLastOwnerOnOtherThread)
+{
+	SharedPTR<A> sp1(new A{ 1, 1.0 });
+	SharedPTR<A> sp2(sp1);
+	std::thread other([moved = std::move(sp2)]() mutable
+	{
+		moved->i = 2;
+		moved.release();
+	});
+	sp1.release();
+	other.join();
+	EXPECT_EQ(sp1.get(), nullptr);
+}
+
+struct Tracked
+{
+	Tracked(int _value, int& _destroyed) : value(_value), destroyed(_destroyed) {}
+	~Tracked() { ++destroyed; }
+
+	int value{};
+	int& destroyed;
+};
+
+class MakeShared : public MemoryLeaksTests {};
+
+TEST_F(MakeShared, Construct)
+{
+	auto sp = make_shared_ptr<A>(1, 1.0);
+	EXPECT_EQ(sp->i, 1);
+	EXPECT_EQ(sp->d, 1.0);
+	EXPECT_EQ(sp.reference_count(), 1);
+	EXPECT_EQ(sp.operator bool(), true);
+}
+
+TEST_F(MakeShared, DestroyedOnceByLastOwner)
+{
+	int destroyed = 0;
+	{
+		auto sp1 = make_shared_ptr<Tracked>(1, destroyed);
+		SharedPTR<Tracked> sp2(sp1);
+		SharedPTR<Tracked> sp3;
+		sp3 = sp2;
+		SharedPTR<Tracked> sp4(std::move(sp3));
+		EXPECT_EQ(sp1.reference_count(), 3);
+
+		sp1.release();
+		sp2.release();
+		EXPECT_EQ(destroyed, 0);
+		EXPECT_EQ(sp4->value, 1);
+	}
+	EXPECT_EQ(destroyed, 1);
+}
+
+TEST_F(MakeShared, ResetToOwnedPointer)
+{
+	int destroyed = 0;
+	auto sp = make_shared_ptr<Tracked>(1, destroyed);
+	sp.reset(new Tracked(2, destroyed));
+	EXPECT_EQ(destroyed, 1);
+	EXPECT_EQ(sp->value, 2);
+	EXPECT_EQ(sp.reference_count(), 1);
+}
+
+TEST_F(MakeShared, SwapWithOwnedPointer)
+{
+	int destroyed = 0;
+	auto sp1 = make_shared_ptr<Tracked>(1, destroyed);
+	SharedPTR<Tracked> sp2(new Tracked(2, destroyed));
+	sp1.swap(sp2);
+	EXPECT_EQ(sp1->value, 2);
+	EXPECT_EQ(sp2->value, 1);
+
+	sp1.release();
+	sp2.release();
+	EXPECT_EQ(destroyed, 2);
+}
+
+TEST_F(MakeShared, LocalCount)
+{
+	auto sp1 = make_shared_ptr<int, LocalCount>(5);
+	SharedPTR<int, std::default_delete<int>, LocalCount> sp2(sp1);
+	EXPECT_EQ(*sp2, 5);
+	EXPECT_EQ(sp1.reference_count(), 2);
+}
@@ -1,16 +1,85 @@
 #pragma once
+#include <atomic>
+#include <memory>
 #include <cassert>
+#include <utility>
+#include <stdexcept>
 
-template <typename Type, typename TDeleter = std::default_delete<Type>>
+/* reference count policies */
+
+// copies and releases may happen on any thread
+struct AtomicCount
+{
+	using Counter = std::atomic<int>;
+
+	static void increment(Counter& count)
+	{
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// true for the last owner, which then sees every write of the others
+	static bool decrement(Counter& count)
+	{
+		return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+	static int load(const Counter& count)
+	{
+		return count.load(std::memory_order_relaxed);
+	}
+};
+
+// all owners stay on one thread
+struct LocalCount
+{
+	using Counter = int;
+
+	static void increment(Counter& count)
+	{
+		++count;
+	}
+
+	static bool decrement(Counter& count)
+	{
+		return --count == 0;
+	}
+
+	static int load(const Counter& count)
+	{
+		return count;
+	}
+};
+
+template <typename Type, typename TDeleter = std::default_delete<Type>, typename TCount = AtomicCount>
 class SharedPTR
 {
-	using SharedPTR_t = SharedPTR<Type, TDeleter>;
+	using SharedPTR_t = SharedPTR<Type, TDeleter, TCount>;
+	using Counter = typename TCount::Counter;
 
 private:
+	// count and object of make_shared_ptr() in one allocation
+	struct Block
+	{
+		Counter count{ 1 };
+		Type object;
+
+		template <typename... Args>
+		Block(Args&&... args) : object(std::forward<Args>(args)...) {}
+	};
+
 	Type* ptr;
-	int* count;
+	Counter* count;
+	Block* block{};		// nullptr if the object and the count were allocated apart
 	TDeleter deleter{};
 
+	// a tag, so that SharedPTR(nullptr) still means SharedPTR(Type*)
+	struct FromBlock {};
+
+	SharedPTR(FromBlock, Block* _block) : ptr(&_block->object), count(&_block->count), block(_block) {}
+
+	template <typename T, typename C, typename... Args>
+	friend SharedPTR<T, std::default_delete<T>, C> make_shared_ptr(Args&&... args);
+
 public:
 
 	/* constructors and destructor */
@@ -21,7 +90,7 @@ public:
 	{
 		if (ptr != nullptr)
 		{
-			count = new int(1);
+			count = new Counter(1);
 		}
 	}
 
@@ -29,18 +98,21 @@ public:
 	{
 		ptr = other.ptr;
 		count = other.count;
+		block = other.block;
 		other.ptr = nullptr;
 		other.count = nullptr;
+		other.block = nullptr;
 	}
 
 	SharedPTR(const SharedPTR_t& other)
 	{
 		ptr = other.ptr;
 		count = other.count;
+		block = other.block;
 		if (ptr != nullptr)
 		{
 			assert(count != nullptr);
-			++(*count);
+			TCount::increment(*count);
 		}
 	}
 
@@ -74,7 +146,7 @@ public:
 	{
 		if (count != nullptr)
 		{
-			return *count;
+			return TCount::load(*count);
 		}
 		return 0;
 	}
@@ -104,9 +176,10 @@ public:
 			release();
 			ptr = other.ptr;
 			count = other.count;
+			block = other.block;
 			if (ptr != nullptr)
 			{
-				++(*count);
+				TCount::increment(*count);
 			}
 		}
 		return *this;
@@ -124,21 +197,24 @@ public:
 	{
 		if (count != nullptr)
 		{
-
-			if (*count > 0)
-			{
-				--(*count);
-			}
-
-			if (*count <= 0)
+			if (TCount::decrement(*count))
 			{
 				assert(ptr != nullptr);
-				deleter(ptr);
-				delete count;
+				if (block != nullptr)
+				{
+					// the object goes with its block, the deleter did not allocate it
+					delete block;
+				}
+				else
+				{
+					deleter(ptr);
+					delete count;
+				}
 			}
 		}
 		ptr = nullptr;
 		count = nullptr;
+		block = nullptr;
 	}
 
 	void reset(Type* obj = nullptr)
@@ -152,7 +228,7 @@ public:
 		if (obj != nullptr)
 		{
 			ptr = obj;
-			count = new int(1);
+			count = new Counter(1);
 		}
 	}
 
@@ -160,5 +236,20 @@ public:
 	{
 		std::swap(ptr, other.ptr);
 		std::swap(count, other.count);
+		std::swap(block, other.block);
 	}
-};
\ No newline at end of file
+};
+
+/* Creates the object and its count with one allocation,
+   the object is destroyed in place and the deleter is not used.
+
+   auto sp = make_shared_ptr<A>(1, 1.0);
+   auto local = make_shared_ptr<A, LocalCount>(1, 1.0); */
+
+template <typename Type, typename TCount = AtomicCount, typename... Args>
+SharedPTR<Type, std::default_delete<Type>, TCount> make_shared_ptr(Args&&... args)
+{
+	using Block = typename SharedPTR<Type, std::default_delete<Type>, TCount>::Block;
+	using FromBlock = typename SharedPTR<Type, std::default_delete<Type>, TCount>::FromBlock;
+	return SharedPTR<Type, std::default_delete<Type>, TCount>(FromBlock{}, new Block(std::forward<Args>(args)...));
+}
\ No newline at end of file